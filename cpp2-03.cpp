@@ -1,6 +1,8 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <new>
 
 class Source {
     const char *p;
@@ -33,20 +35,67 @@ public:
     }
 };
 
+/*
+the arena that owns the closures of a grammar: they are placed next to
+each other in blocks, shared by pointer and destroyed with the arena
+*/
+class Arena {
+public:
+    struct Object {
+        virtual ~Object() {}
+    };
+private:
+    union Align { long l; double d; long double ld; void *p; };
+    enum { BlockSize = 4096 };
+    std::vector<char *> blocks;
+    std::size_t used;
+    std::vector<Object *> objects;
+    Arena(const Arena &);
+    void operator=(const Arena &);
+public:
+    Arena() : used(BlockSize) {}
+    ~Arena() {
+        for (std::size_t i = objects.size(); i > 0; --i) objects[i - 1]->~Object();
+        for (std::size_t i = 0; i < blocks.size(); ++i) delete[] blocks[i];
+    }
+    void *alloc(std::size_t size) {
+        size = (size + sizeof(Align) - 1) / sizeof(Align) * sizeof(Align);
+        if (size > BlockSize) {
+            blocks.insert(blocks.begin(), new char[size]);
+            return blocks.front();
+        }
+        if (used + size > BlockSize) {
+            blocks.push_back(new char[BlockSize]);
+            used = 0;
+        }
+        void *p = blocks.back() + used;
+        used += size;
+        return p;
+    }
+    template <typename C>
+    const C *make(const C &c) {
+        C *p = new (alloc(sizeof(C))) C(c);
+        objects.push_back(p);
+        return p;
+    }
+};
+Arena grammar;
+
 template <typename T>
-struct Closure {
-    virtual ~Closure() {}
-    virtual Closure *clone() const = 0;
+struct Closure : public Arena::Object {
     virtual T operator()(Source *s) const = 0;
 };
 
+/*
+a closure in the grammar: copies of a Parser share it
+*/
 template <typename T>
 class Parser {
-    Closure<T> *p;
+    const Closure<T> *p;
 public:
-    Closure<T> &get() const { return *p; }
-    Parser(const Closure<T> &p) : p(p.clone()) {}
-    ~Parser() { delete p; }
+    const Closure<T> &get() const { return *p; }
+    template <typename C>
+    Parser(const C &c) : p(grammar.make(c)) {}
     T operator()(Source *s) const { return (*p)(s); }
 };
 
@@ -71,7 +120,6 @@ anyChar = StateT $ anyChar where
     anyChar    xs  = Left ("too short", xs)
 */
 struct AnyChar : public Closure<char> {
-    virtual Closure *clone() const { return new AnyChar; }
     virtual char operator()(Source *s) const {
         char ch = s->peek();
         s->next();
@@ -87,7 +135,6 @@ class Char1 : public Closure<char> {
     char ch;
 public:
     Char1(char ch) : ch(ch) {}
-    virtual Closure *clone() const { return new Char1(ch); }
     virtual char operator()(Source *s) const {
         char ch = s->peek();
         if (this->ch != ch) {
@@ -108,7 +155,6 @@ class Satisfy : public Closure<char> {
     bool (*f)(char);
 public:
     Satisfy(bool (*f)(char)) : f(f) {}
-    virtual Closure *clone() const { return new Satisfy(f); }
     virtual char operator()(Source *s) const {
         char ch = s->peek();
         if (!f(ch)) throw s->ex(std::string("error: '") + ch + "'");
@@ -128,7 +174,6 @@ class Left : public Closure<T> {
     std::string msg;
 public:
     Left(const std::string &msg) : msg(msg) {}
-    virtual Closure<T> *clone() const { return new Left(msg); }
     virtual T operator()(Source *s) const {
         char ch = s->peek();
         throw s->ex(msg + ": '" + ch + "'");
@@ -146,22 +191,20 @@ Parser<T> left(const std::string &msg) {
 template <typename T, typename T1>
 class UnaryOperator : public Closure<T> {
 protected:
-    Closure<T1> *p;
+    const Closure<T1> *p;
 public:
-    UnaryOperator(const Closure<T1> &p) : p(p.clone()) {}
-    virtual ~UnaryOperator() { delete p; }
+    UnaryOperator(const Closure<T1> &p) : p(&p) {}
 };
 
 /**/
 template <typename T, typename T1, typename T2>
 class BinaryOperator : public Closure<T> {
 protected:
-    Closure<T1> *p1;
-    Closure<T2> *p2;
+    const Closure<T1> *p1;
+    const Closure<T2> *p2;
 public:
     BinaryOperator(const Closure<T1> &p1, const Closure<T2> &p2) :
-        p1(p1.clone()), p2(p2.clone()) {}
-    virtual ~BinaryOperator() { delete p1; delete p2; }
+        p1(&p1), p2(&p2) {}
 };
 
 /* sequence */
@@ -169,9 +212,6 @@ template <typename T1, typename T2>
 struct Sequence : public BinaryOperator<std::string, T1, T2> {
     Sequence(const Closure<T1> &p1, const Closure<T2> &p2) :
         BinaryOperator<std::string, T1, T2>(p1, p2) {}
-    virtual Closure<std::string> *clone() const {
-        return new Sequence(*this->p1, *this->p2);
-    }
     virtual std::string operator()(Source *s) const {
         std::string ret;
         ret += (*this->p1)(s);
@@ -194,9 +234,6 @@ class Replicate : public UnaryOperator<std::string, T> {
 public:
     Replicate(int n, const Closure<T> &p) :
         UnaryOperator<std::string, T>(p), n(n) {}
-    virtual Closure<std::string> *clone() const {
-        return new Replicate(n, *this->p);
-    }
     virtual std::string operator()(Source *s) const {
         std::string ret;
         for (int i = 0; i < n; ++i) ret += (*this->p)(s);
@@ -224,7 +261,6 @@ template <typename T>
 struct Or : public BinaryOperator<T, T, T> {
     Or(const Closure<T> &p1, const Closure<T> &p2) :
         BinaryOperator<T, T, T>(p1, p2) {}
-    virtual Closure<T> *clone() const { return new Or(*this->p1, *this->p2); }
     virtual T operator()(Source *s) const {
         T ret;
         Source ss = *s;
@@ -250,7 +286,6 @@ try (StateT p) = StateT $ \s -> case p s of
 template <typename T>
 struct Try : public UnaryOperator<T, T> {
     Try(const Closure<T> &p) : UnaryOperator<T, T>(p) {}
-    virtual Closure<T> *clone() const { return new Try<T>(*this->p); }
     virtual T operator()(Source *s) const {
         T ret;
         Source ss = *s;
@@ -275,7 +310,6 @@ class String : public Closure<std::string> {
     std::string str;
 public:
     String(const std::string &str) : str(str) {}
-    virtual Closure *clone() const { return new String(str); }
     virtual std::string operator()(Source *s) const {
         for (int i = 0; i < str.length(); ++i) {
             char ch = s->peek();
@@ -297,7 +331,6 @@ many p = ((:) <$> p <*> many p) <|> return []
 template <typename T>
 struct Many : public UnaryOperator<std::string, T> {
     Many(const Closure<T> &p) : UnaryOperator<std::string, T>(p) {}
-    virtual Closure<std::string> *clone() const { return new Many<T>(*this->p); }
     virtual std::string operator()(Source *s) const {
         std::string ret;
         try {
@@ -1,8 +1,11 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <new>
 #include <list>
 #include <numeric>
+#include <limits>
 
 template <typename T>
 std::string toString(const std::list<T> &list) {
@@ -40,6 +43,7 @@ class Source {
     int line, col;
 public:
     Source(const char *p) : p(p), line(1), col(1) {}
+    bool eof() const { return !*p; }
     char peek() {
         if (!*p) throw ex("too short");
         return *p;
@@ -66,23 +70,86 @@ public:
     }
 };
 
+/*
+the arena that owns the closures of a grammar: they are placed next to
+each other in blocks, shared by pointer and destroyed with the arena
+*/
+class Arena {
+public:
+    struct Object {
+        virtual ~Object() {}
+    };
+private:
+    union Align { long l; double d; long double ld; void *p; };
+    enum { BlockSize = 4096 };
+    std::vector<char *> blocks;
+    std::size_t used;
+    std::vector<Object *> objects;
+    Arena(const Arena &);
+    void operator=(const Arena &);
+public:
+    Arena() : used(BlockSize) {}
+    ~Arena() {
+        for (std::size_t i = objects.size(); i > 0; --i) objects[i - 1]->~Object();
+        for (std::size_t i = 0; i < blocks.size(); ++i) delete[] blocks[i];
+    }
+    void *alloc(std::size_t size) {
+        size = (size + sizeof(Align) - 1) / sizeof(Align) * sizeof(Align);
+        if (size > BlockSize) {
+            blocks.insert(blocks.begin(), new char[size]);
+            return blocks.front();
+        }
+        if (used + size > BlockSize) {
+            blocks.push_back(new char[BlockSize]);
+            used = 0;
+        }
+        void *p = blocks.back() + used;
+        used += size;
+        return p;
+    }
+    template <typename C>
+    const C *make(const C &c) {
+        C *p = new (alloc(sizeof(C))) C(c);
+        objects.push_back(p);
+        return p;
+    }
+};
+Arena grammar;
+
 template <typename T>
-struct Closure {
-    virtual ~Closure() {}
-    virtual Closure *clone() const = 0;
+struct Closure : public Arena::Object {
     virtual T operator()(Source *s) const = 0;
 };
 
+/*
+a closure in the grammar: copies of a Parser share it
+*/
 template <typename T>
 class Parser {
-    Closure<T> *p;
+    const Closure<T> *p;
 public:
-    Closure<T> &get() const { return *p; }
-    Parser(const Closure<T> &p) : p(p.clone()) {}
-    ~Parser() { delete p; }
+    const Closure<T> &get() const { return *p; }
+    template <typename C>
+    Parser(const C &c) : p(grammar.make(c)) {}
     T operator()(Source *s) const { return (*p)(s); }
 };
 
+/*
+a rule used before it is defined: refers to the Parser itself,
+whose closure is not made yet, so a recursive grammar can be built once
+*/
+template <typename T>
+class Ref : public Closure<T> {
+    const Parser<T> *p;
+public:
+    Ref(const Parser<T> &p) : p(&p) {}
+    virtual T operator()(Source *s) const { return (*p)(s); }
+};
+template <typename T>
+Parser<T> ref(const Parser<T> &p) {
+    return Ref<T>(p);
+}
+
 /*
 parseTest p s = case evalStateT p s of
     Right r     -> print r
@@ -104,7 +171,6 @@ anyChar = StateT $ anyChar where
     anyChar    xs  = Left ("too short", xs)
 */
 struct AnyChar : public Closure<char> {
-    virtual Closure *clone() const { return new AnyChar; }
     virtual char operator()(Source *s) const {
         char ch = s->peek();
         s->next();
@@ -120,7 +186,6 @@ class Char1 : public Closure<char> {
     char ch;
 public:
     Char1(char ch) : ch(ch) {}
-    virtual Closure *clone() const { return new Char1(ch); }
     virtual char operator()(Source *s) const {
         char ch = s->peek();
         if (this->ch != ch) {
@@ -141,7 +206,6 @@ class Satisfy : public Closure<char> {
     bool (*f)(char);
 public:
     Satisfy(bool (*f)(char)) : f(f) {}
-    virtual Closure *clone() const { return new Satisfy(f); }
     virtual char operator()(Source *s) const {
         char ch = s->peek();
         if (!f(ch)) throw s->ex(std::string("error: '") + ch + "'");
@@ -159,7 +223,6 @@ class Right : public Closure<T> {
     T r;
 public:
     Right(const T &r) : r(r) {}
-    virtual Closure<T> *clone() const { return new Right(r); }
     virtual T operator()(Source *s) const {
         return r;
     }
@@ -177,7 +240,6 @@ class Left : public Closure<T> {
     std::string msg;
 public:
     Left(const std::string &msg) : msg(msg) {}
-    virtual Closure<T> *clone() const { return new Left(msg); }
     virtual T operator()(Source *s) const {
         char ch = s->peek();
         throw s->ex(msg + ": '" + ch + "'");
@@ -195,22 +257,20 @@ Parser<T> left(const std::string &msg) {
 template <typename T, typename T1>
 class UnaryOperator : public Closure<T> {
 protected:
-    Closure<T1> *p;
+    const Closure<T1> *p;
 public:
-    UnaryOperator(const Closure<T1> &p) : p(p.clone()) {}
-    virtual ~UnaryOperator() { delete p; }
+    UnaryOperator(const Closure<T1> &p) : p(&p) {}
 };
 
 /**/
 template <typename T, typename T1, typename T2>
 class BinaryOperator : public Closure<T> {
 protected:
-    Closure<T1> *p1;
-    Closure<T2> *p2;
+    const Closure<T1> *p1;
+    const Closure<T2> *p2;
 public:
     BinaryOperator(const Closure<T1> &p1, const Closure<T2> &p2) :
-        p1(p1.clone()), p2(p2.clone()) {}
-    virtual ~BinaryOperator() { delete p1; delete p2; }
+        p1(&p1), p2(&p2) {}
 };
 
 /* >>, *> */
@@ -218,9 +278,6 @@ template <typename T1, typename T2>
 struct ReturnRight : public BinaryOperator<T2, T1, T2> {
     ReturnRight(const Closure<T1> &p1, const Closure<T2> &p2) :
         BinaryOperator<T2, T1, T2>(p1, p2) {}
-    virtual Closure<T2> *clone() const {
-        return new ReturnRight(*this->p1, *this->p2);
-    }
     virtual T2 operator()(Source *s) const {
         (*this->p1)(s);
         return (*this->p2)(s);
@@ -236,9 +293,6 @@ template <typename T1, typename T2>
 struct ReturnLeft : public BinaryOperator<T1, T1, T2> {
     ReturnLeft(const Closure<T1> &p1, const Closure<T2> &p2) :
         BinaryOperator<T1, T1, T2>(p1, p2) {}
-    virtual Closure<T1> *clone() const {
-        return new ReturnLeft(*this->p1, *this->p2);
-    }
     virtual T1 operator()(Source *s) const {
         T1 ret = (*this->p1)(s);
         (*this->p2)(s);
@@ -255,9 +309,6 @@ template <typename T1, typename T2>
 struct Sequence : public BinaryOperator<std::string, T1, T2> {
     Sequence(const Closure<T1> &p1, const Closure<T2> &p2) :
         BinaryOperator<std::string, T1, T2>(p1, p2) {}
-    virtual Closure<std::string> *clone() const {
-        return new Sequence(*this->p1, *this->p2);
-    }
     virtual std::string operator()(Source *s) const {
         std::string ret;
         ret += (*this->p1)(s);
@@ -280,9 +331,6 @@ class Replicate : public UnaryOperator<std::string, T> {
 public:
     Replicate(int n, const Closure<T> &p) :
         UnaryOperator<std::string, T>(p), n(n) {}
-    virtual Closure<std::string> *clone() const {
-        return new Replicate(n, *this->p);
-    }
     virtual std::string operator()(Source *s) const {
         std::string ret;
         for (int i = 0; i < n; ++i) ret += (*this->p)(s);
@@ -310,7 +358,6 @@ template <typename T>
 struct Or : public BinaryOperator<T, T, T> {
     Or(const Closure<T> &p1, const Closure<T> &p2) :
         BinaryOperator<T, T, T>(p1, p2) {}
-    virtual Closure<T> *clone() const { return new Or(*this->p1, *this->p2); }
     virtual T operator()(Source *s) const {
         T ret;
         Source ss = *s;
@@ -336,7 +383,6 @@ try (StateT p) = StateT $ \s -> case p s of
 template <typename T>
 struct Try : public UnaryOperator<T, T> {
     Try(const Closure<T> &p) : UnaryOperator<T, T>(p) {}
-    virtual Closure<T> *clone() const { return new Try<T>(*this->p); }
     virtual T operator()(Source *s) const {
         T ret;
         Source ss = *s;
@@ -361,7 +407,6 @@ class String : public Closure<std::string> {
     std::string str;
 public:
     String(const std::string &str) : str(str) {}
-    virtual Closure *clone() const { return new String(str); }
     virtual std::string operator()(Source *s) const {
         for (int i = 0; i < str.length(); ++i) {
             char ch = s->peek();
@@ -383,7 +428,6 @@ many p = ((:) <$> p <*> many p) <|> return []
 template <typename T>
 struct Many : public UnaryOperator<std::string, T> {
     Many(const Closure<T> &p) : UnaryOperator<std::string, T>(p) {}
-    virtual Closure<std::string> *clone() const { return new Many<T>(*this->p); }
     virtual std::string operator()(Source *s) const {
         std::string ret;
         try {
@@ -401,7 +445,6 @@ Parser<std::string> many(const Parser<std::string> &p) {
 template <typename T>
 struct ManyList : public UnaryOperator<std::list<T>, T> {
     ManyList(const Closure<T> &p) : UnaryOperator<std::list<T>, T>(p) {}
-    virtual Closure< std::list<T> > *clone() const { return new ManyList<T>(*this->p); }
     virtual std::list<T> operator()(Source *s) const {
         std::list<T> ret;
         try {
@@ -421,7 +464,6 @@ many1 p = (:) <$> p <*> many p
 template <typename T>
 struct Many1 : public UnaryOperator<std::list<T>, T> {
     Many1(const Closure<T> &p) : UnaryOperator<std::list<T>, T>(p) {}
-    virtual Closure< std::list<T> > *clone() const { return new Many1<T>(*this->p); }
     virtual std::list<T> operator()(Source *s) const {
         std::list<T> ret;
         ret.push_back((*this->p)(s));
@@ -507,11 +549,16 @@ number = do
     return (read x :: Int)
 */
 struct Number : public Closure<int> {
-    virtual Closure *clone() const { return new Number; }
     virtual int operator()(Source *s) const {
-        std::string x = many1(digit)(s);
-        int ret;
-        std::istringstream(x) >> ret;
+        int ret = digit(s) - '0';
+        while (!s->eof() && isDigit(s->peek())) {
+            int d = s->peek() - '0';
+            if (ret > (std::numeric_limits<int>::max() - d) / 10) {
+                throw s->ex("number out of range");
+            }
+            ret = ret * 10 + d;
+            s->next();
+        }
         return ret;
     }
 };
@@ -526,6 +573,17 @@ int eval(int m, const std::list< Bind<int> > &fs) {
     }
     return m;
 }
+struct Eval : public BinaryOperator<int, int, std::list< Bind<int> > > {
+    Eval(const Closure<int> &p1, const Closure< std::list< Bind<int> > > &p2) :
+        BinaryOperator<int, int, std::list< Bind<int> > >(p1, p2) {}
+    virtual int operator()(Source *s) const {
+        int x = (*p1)(s);
+        return eval(x, (*p2)(s));
+    }
+};
+Parser<int> eval(const Parser<int> &m, const Parser< std::list< Bind<int> > > &fs) {
+    return Eval(m.get(), fs.get());
+}
 
 /*
 apply f m = flip f <$> m
@@ -535,7 +593,6 @@ class Apply : public UnaryOperator<Bind<int>, int> {
 public:
     Apply(const Closure<int> &p, int (*f)(int, int)) :
         UnaryOperator(p), f(f) {}
-    virtual Closure *clone() const { return new Apply(*p, f); }
     virtual Bind<int> operator()(Source *s) const {
         return bind(f, (*p)(s));
     }
@@ -544,6 +601,11 @@ Parser< Bind<int> > apply(int (*f)(int, int), const Parser<int> &p) {
     return Apply(p.get(), f);
 }
 
+int mul(int x, int y) { return y * x; }
+int quo(int x, int y) { return y / x; }
+int add(int x, int y) { return y + x; }
+int sub(int x, int y) { return y - x; }
+
 /*
 -- term = factor, {("*", factor) | ("/", factor)}
 term = eval factor $ many $
@@ -551,20 +613,10 @@ term = eval factor $ many $
     <|> char '/' *> apply div factor
 */
 extern Parser<int> factor;
-struct Term : public Closure<int> {
-    virtual Closure *clone() const { return new Term; }
-    static int mul(int x, int y) { return y * x; }
-    static int div(int x, int y) { return y / x; }
-    virtual int operator()(Source *s) const {
-        int x = factor(s);
-        std::list< Bind<int> > xs = many(
-               char1('*') >> apply(mul, factor)
-            || char1('/') >> apply(div, factor)
-        )(s);
-        return eval(x, xs);
-    }
-};
-Parser<int> term = Term();
+Parser<int> term = eval(ref(factor), many(
+       char1('*') >> apply(mul, ref(factor))
+    || char1('/') >> apply(quo, ref(factor))
+));
 
 /*
 -- expr = term, {("+", term) | ("-", term)}
@@ -572,20 +624,10 @@ expr = eval term $ many $
         char '+' *> apply (+) term
     <|> char '-' *> apply (-) term
 */
-struct Expr : public Closure<int> {
-    virtual Closure *clone() const { return new Expr; }
-    static int add(int x, int y) { return y + x; }
-    static int sub(int x, int y) { return y - x; }
-    virtual int operator()(Source *s) const {
-        int x = term(s);
-        std::list< Bind<int> > xs = many(
-               char1('+') >> apply(add, term)
-            || char1('-') >> apply(sub, term)
-        )(s);
-        return eval(x, xs);
-    }
-};
-Parser<int> expr = Expr();
+Parser<int> expr = eval(ref(term), many(
+       char1('+') >> apply(add, ref(term))
+    || char1('-') >> apply(sub, ref(term))
+));
 
 /*
 -- factor = [spaces], ("(", expr, ")") | number, [spaces]
@@ -594,7 +636,7 @@ factor = spaces
      <*  spaces
 */
 Parser<int> factor = spaces
-                  >> (char1('(') >> expr << char1(')') || number)
+                  >> (char1('(') >> ref(expr) << char1(')') || number)
                   << spaces;
 
 /*
@@ -3,6 +3,7 @@
 #include <string>
 #include <list>
 #include <numeric>
+#include <limits>
 #include <functional>
 
 template <typename T>
@@ -41,6 +42,7 @@ class Source {
     int line, col;
 public:
     Source(const char *p) : p(p), line(1), col(1) {}
+    bool eof() const { return !*p; }
     char peek() {
         if (!*p) throw ex("too short");
         return *p;
@@ -350,9 +352,15 @@ number = do
     return (read x :: Int)
 */
 Parser<int> number = [](Source *s) {
-    std::string x = many1(digit)(s);
-    int ret;
-    std::istringstream(x) >> ret;
+    int ret = digit(s) - '0';
+    while (!s->eof() && isDigit(s->peek())) {
+        int d = s->peek() - '0';
+        if (ret > (std::numeric_limits<int>::max() - d) / 10) {
+            throw s->ex("number out of range");
+        }
+        ret = ret * 10 + d;
+        s->next();
+    }
     return ret;
 };
 
@@ -1,33 +1,83 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <system_error>
+#include <cerrno>
+#include <memory>
 #include <list>
 #include <numeric>
 #include <functional>
+#include <type_traits>
+#include <stdexcept>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <unordered_map>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <charconv>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <exception>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#if defined(__GNUC__)
+#define PARSECPP_COLD __attribute__((cold, noinline))
+#else
+#define PARSECPP_COLD
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#define PARSECPP_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
 
-template <typename T>
-std::string toString(const std::list<T> &list) {
+template <typename It>
+std::string toString(It first, It last) {
     std::stringstream ss;
     ss << "[";
-    for (auto it = list.begin();
-            it != list.end(); ++it) {
-        if (it != list.begin()) ss << ",";
+    for (auto it = first; it != last; ++it) {
+        if (it != first) ss << ",";
         ss << *it;
     }
     ss << "]";
     return ss.str();
 }
 template <typename T>
+std::string toString(const std::list<T> &list) {
+    return toString(list.begin(), list.end());
+}
+template <typename T>
+std::string toString(const std::vector<T> &vector) {
+    return toString(vector.begin(), vector.end());
+}
+template <typename T>
 std::ostream &operator<<(std::ostream &cout, const std::list<T> &list) {
     return cout << toString(list);
 }
+template <typename T>
+std::ostream &operator<<(std::ostream &cout, const std::vector<T> &vector) {
+    return cout << toString(vector);
+}
 
 /* : */
 template <typename T>
-std::list<T> operator+(T x, const std::list<T> &list) {
-    std::list<T> ret = list;
-    ret.push_front(x);
-    return ret;
+std::list<T> operator+(T x, std::list<T> list) {
+    list.push_front(std::move(x));
+    return list;
 }
 
 /* sum */
@@ -35,311 +85,2246 @@ template <typename T>
 T sum(const std::list<T> &list) {
     return std::accumulate(list.begin(), list.end(), 0);
 }
+template <typename T>
+T sum(const std::vector<T> &vector) {
+    return std::accumulate(vector.begin(), vector.end(), 0);
+}
+
+/*
+an item of "expecting ..." in an error message: the text belongs to
+the parser, which can be a temporary, so Source copies what it keeps
+*/
+struct Expect {
+    enum Kind { Char, String, Label, Message } kind;
+    char ch;
+    const char *text;
+
+    static Expect char1  (char ch)          { Expect e = { Char   , ch, 0    }; return e; }
+    static Expect string (const char *text) { Expect e = { String , 0 , text }; return e; }
+    static Expect label  (const char *text) { Expect e = { Label  , 0 , text }; return e; }
+    static Expect message(const char *text) { Expect e = { Message, 0 , text }; return e; }
+};
+
+std::string showChar(char ch) {
+    switch (ch) {
+    case '\0': return "'\\0'";
+    case '\t': return "'\\t'";
+    case '\n': return "'\\n'";
+    case '\r': return "'\\r'";
+    }
+    if (0 <= ch && ch < ' ') {
+        static const char hex[] = "0123456789abcdef";
+        return std::string("'\\x") + hex[ch >> 4] + hex[ch & 15] + "'";
+    }
+    return std::string("'") + ch + "'";
+}
+
+/*
+the input that a verbatim parser such as many letter consumed: a view
+of the input when Source holds all of it, otherwise a copy, as reading
+a stream can move its buffer. A std::string is made only on demand.
+*/
+class Span {
+    std::shared_ptr<const std::string> copy;
+    std::string_view v;
+public:
+    Span() {}
+    Span(std::string_view v) : v(v) {}
+    explicit Span(std::string s) :
+        copy(std::make_shared<const std::string>(std::move(s))), v(*copy) {}
+    operator std::string_view() const { return v; }
+    operator std::string() const { return std::string(v); }
+    std::string str() const { return std::string(v); }
+    const char *data() const { return v.data(); }
+    std::size_t size() const { return v.size(); }
+    bool operator==(std::string_view s) const { return v == s; }
+    bool operator!=(std::string_view s) const { return v != s; }
+};
+std::ostream &operator<<(std::ostream &os, const Span &s) {
+    return os << std::string_view(s);
+}
+
+/* () */
+struct Unit {};
+std::ostream &operator<<(std::ostream &os, Unit) { return os << "()"; }
+std::string &operator+=(std::string &s, Unit) { return s; }
+
+/*
+offsets of '\n' in s[0, n), counted from off,
+16 bytes at a time where SSE2 is available
+*/
+void scanLines(std::vector<std::uint64_t> *lines,
+        const char *s, std::size_t n, std::uint64_t off) {
+    std::size_t i = 0;
+#ifdef __SSE2__
+    const __m128i nl = _mm_set1_epi8('\n');
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+        unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+        for (; m; m &= m - 1) lines->push_back(off + i + __builtin_ctz(m));
+    }
+#endif
+    for (; i < n; ++i) {
+        if (s[i] == '\n') lines->push_back(off + i);
+    }
+}
+
+/*
+where a streaming Source gets more input: read() returns 0 at the end
+*/
+struct Reader {
+    virtual ~Reader() {}
+    virtual std::size_t read(char *buf, std::size_t len) = 0;
+};
+
+class FdReader : public Reader {
+    int fd;
+public:
+    FdReader(int fd) : fd(fd) {}
+    virtual std::size_t read(char *buf, std::size_t len) {
+#ifdef PARSECPP_MMAP
+        for (;;) {
+            ssize_t n = ::read(fd, buf, len);
+            if (n >= 0) return n;
+            if (errno != EINTR) throw std::system_error(errno, std::generic_category());
+        }
+#else
+        throw std::system_error(ENOSYS, std::generic_category());
+#endif
+    }
+};
+
+class StreamReader : public Reader {
+    std::istream &is;
+public:
+    StreamReader(std::istream &is) : is(is) {}
+    virtual std::size_t read(char *buf, std::size_t len) {
+        // wait for one byte, then take what is there without blocking;
+        // a buffer that cannot tell, as std::cin synced with stdio, is
+        // read a block at a time
+        if (is.peek() == std::char_traits<char>::eof()) return 0;
+        std::size_t n = is.readsome(buf, len);
+        if (n == 0) n = is.rdbuf()->sgetn(buf, len);
+        return n;
+    }
+};
+
+/*
+Left (e, s): the furthest failure and what was expected there.
+Failures at the same position are merged like Left (b ++ a, s2),
+and the message is formatted only when it is asked for.
+
+Source is a pointer and length, so the input may contain NUL bytes
+and need not be terminated. Offsets are 64-bit for files over 4 GB.
+It only moves a pointer: line and column are worked out from the
+offset when a message is made, unless PARSECPP_NO_LINECOL is defined,
+in which case messages show the offset.
 
+A Source made from a Reader pulls input a block at a time as peek()
+runs past it. Only the bytes from the oldest keep() that is not yet
+released are held, so an endless stream is parsed in bounded memory.
+*/
 class Source {
-    const char *p;
-    int line, col;
+    enum { MaxExpects = 8, BlockSize = 65536 };
+    const char *begin, *p, *end;
+    std::uint64_t base = 0;
+    std::unique_ptr<Reader> reader;
+    std::vector<char> buf;
+    int holds = 0;
+    std::uint64_t held = 0;
+    // what a many item that failed consumed: left out of any span
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> cuts;
+    std::uint64_t eoff = 0;
+    Expect expects[MaxExpects];
+    std::string texts[MaxExpects];
+    int nexpects = 0;
+    std::string raw;
+    // the byte failed at and its place, if it has been dropped
+    bool eaten = false;
+    int ech = 0;
+#ifndef PARSECPP_NO_LINECOL
+    std::uint64_t eline = 0, ecol = 0;
+    // '\n' in the bytes held, with those dropped before them counted
+    mutable std::vector<std::uint64_t> lines;
+    mutable std::uint64_t scanned = 0, nlines = 0, bol = 0;
+#endif
+public:
+    /* what one rule gave at each offset, kept for this parse */
+    struct MemoTable {
+        virtual ~MemoTable() {}
+    };
+private:
+    std::unordered_map<const void *, std::unique_ptr<MemoTable>> memos;
+    bool memoAll = false;
+
+    std::uint64_t offset() const { return base + (p - begin); }
+#ifdef PARSECPP_NO_LINECOL
+    std::string at(std::uint64_t off) const {
+        std::stringstream ss;
+        ss << "[offset " << off << "] ";
+        return ss.str();
+    }
+#else
+    void scanTo(std::uint64_t off) const {
+        if (scanned < off) {
+            scanLines(&lines, begin + (scanned - base), off - scanned, scanned);
+            scanned = off;
+        }
+    }
+    void lineCol(std::uint64_t off, std::uint64_t *line, std::uint64_t *col) const {
+        scanTo(off);
+        std::size_t i = std::lower_bound(
+            lines.begin(), lines.end(), off) - lines.begin();
+        *line = nlines + i;
+        *col  = off - (i ? lines[i - 1] + 1 : bol);
+    }
+    static std::string at(std::uint64_t line, std::uint64_t col) {
+        std::stringstream ss;
+        ss << "[line " << line + 1 << ", col " << col + 1 << "] ";
+        return ss.str();
+    }
+    std::string at(std::uint64_t off) const {
+        std::uint64_t line, col;
+        lineCol(off, &line, &col);
+        return at(line, col);
+    }
+#endif
+    /* drop the bytes nothing can go back to and read a block */
+    bool fill() {
+        if (!reader) return false;
+        std::uint64_t cur = offset(), from = holds ? held : cur;
+        std::size_t cut = from - base, len = end - begin;
+        // the failure's byte goes: keep it and its place, unformatted
+        if (!eaten && eoff < from) {
+            eaten = true;
+            ech = begin[eoff - base];
+#ifndef PARSECPP_NO_LINECOL
+            lineCol(eoff, &eline, &ecol);
+#endif
+        }
+#ifndef PARSECPP_NO_LINECOL
+        scanTo(from);
+        std::size_t i = std::lower_bound(
+            lines.begin(), lines.end(), from) - lines.begin();
+        if (i) {
+            nlines += i;
+            bol = lines[i - 1] + 1;
+            lines.erase(lines.begin(), lines.begin() + i);
+        }
+#endif
+        std::memmove(buf.data(), buf.data() + cut, len - cut);
+        len -= cut;
+        base = from;
+        if (buf.size() - len < BlockSize) buf.resize(buf.size() * 2);
+        std::size_t n = reader->read(buf.data() + len, buf.size() - len);
+        begin = buf.data();
+        p     = begin + (cur - base);
+        end   = begin + len + n;
+        return n > 0;
+    }
 public:
-    Source(const char *p) : p(p), line(1), col(1) {}
+    /* a saved position to compare with or to rewind to */
+    struct Mark {
+        std::uint64_t offset;
+    };
+    Source(const char *p, std::size_t len) : begin(p), p(p), end(p + len) {}
+    Source(std::string_view s) : Source(s.data(), s.size()) {}
+    Source(const char *p) : Source(p, std::strlen(p)) {}
+    explicit Source(std::unique_ptr<Reader> r) :
+            begin(0), p(0), end(0), reader(std::move(r)), buf(BlockSize) {
+        begin = p = end = buf.data();
+    }
+    explicit Source(std::istream &is) :
+        Source(std::unique_ptr<Reader>(new StreamReader(is))) {}
+    bool eof() { return p == end && !fill(); }
+    /* unchecked, after eof() has returned false */
+    char current() const { return *p; }
+    void advance(std::size_t n = 1) { p += n; }
+    /* the bytes read but not consumed yet */
+    const char *ptr() const { return p; }
+    const char *limit() const { return end; }
     char peek() {
-        if (!*p) throw ex("too short");
+        if (eof()) throw ex("too short");
         return *p;
     }
     void next() {
-        if (!*p) throw ex("at last");
-        if (*p == '\n') {
-            ++line;
-            col = 0;
-        }
+        if (eof()) throw ex("at last");
         ++p;
-        ++col;
     }
     std::string ex(const std::string &msg) {
-        std::stringstream ss;
-        ss << "[line " << line << ", col " << col << "] " << msg;
-        return ss.str();
+        return at(offset()) + msg;
     }
     bool operator==(const Source &s) {
-        return p == s.p && line == s.line && col == s.col;
+        return offset() == s.offset();
     }
     bool operator!=(const Source &s) {
         return !(*this == s);
     }
+    Mark mark() const {
+        Mark m = { offset() };
+        return m;
+    }
+    bool moved(const Mark &m) const { return offset() != m.offset; }
+    /* a mark that can be rewound to: the bytes after it are kept */
+    Mark keep() {
+        if (holds++ == 0) held = offset();
+        return mark();
+    }
+    void release(const Mark &) {
+        if (--holds == 0) cuts.clear();
+    }
+    /* leave the bytes from a mark to here out of the spans around them */
+    void cut(const Mark &m) {
+        if (holds && moved(m)) cuts.emplace_back(m.offset, offset());
+    }
+    /* the bytes from a mark, which has to be kept, to here */
+    Span span(const Mark &m) const {
+        std::string_view v(begin + (m.offset - base), offset() - m.offset);
+        if (!cuts.empty() && cuts.back().second > m.offset) {
+            std::string ret;
+            std::uint64_t from = m.offset;
+            for (const auto &c : cuts) {
+                if (c.second <= from) continue;
+                ret.append(begin + (from - base), c.first - from);
+                from = c.second;
+            }
+            ret.append(begin + (from - base), offset() - from);
+            return Span(std::move(ret));
+        }
+        return reader ? Span(std::string(v)) : Span(v);
+    }
+    /* consume n bytes that have been read */
+    Span take(std::size_t n) {
+        std::string_view v(p, n);
+        p += n;
+        return reader ? Span(std::string(v)) : Span(v);
+    }
+    /* also forward, to where a memoized rule stopped */
+    void rewind(const Mark &m) {
+        p = begin + (m.offset - base);
+        while (!cuts.empty() && cuts.back().first >= m.offset) cuts.pop_back();
+        if (!cuts.empty() && cuts.back().second > m.offset)
+            cuts.back().second = m.offset;
+    }
+    /* whether every Parser is to be memoized */
+    void memoize(bool all = true) { memoAll = all; }
+    bool memoizing() const { return memoAll; }
+    template <typename M>
+    M &memoTable(const void *rule) {
+        std::unique_ptr<MemoTable> &m = memos[rule];
+        if (!m) m.reset(new M);
+        return static_cast<M &>(*m);
+    }
+    /* record a failure at the current position */
+    PARSECPP_COLD void fail() {
+        std::uint64_t off = offset();
+        if (off < eoff) return;
+        if (off > eoff) {
+            eoff = off;
+            nexpects = 0;
+            raw.clear();
+            eaten = false;
+        }
+    }
+    PARSECPP_COLD void fail(const Expect &e) {
+        fail();
+        if (offset() < eoff || nexpects == MaxExpects) return;
+        for (int i = 0; i < nexpects; ++i) {
+            if (expects[i].kind == e.kind && expects[i].ch == e.ch
+                    && texts[i] == (e.text ? e.text : "")) return;
+        }
+        texts[nexpects] = e.text ? e.text : "";
+        expects[nexpects++] = e;
+    }
+    /* the expected items recorded at a mark, or -1 if past it */
+    int expectsAt(const Mark &m) const {
+        return eoff > m.offset ? -1 : eoff == m.offset ? nexpects : 0;
+    }
+    /* move the items from mid on before those from k on */
+    void hoistExpects(int k, int mid) {
+        std::rotate(expects + k, expects + mid, expects + nexpects);
+        std::rotate(texts + k, texts + mid, texts + nexpects);
+    }
+    /* forget the items recorded at a mark from k on */
+    void dropExpects(int k) { nexpects = k; }
+    /* a message thrown by a hand-written parser, already formatted */
+    void fail(const std::string &msg) {
+        fail();
+        if (offset() == eoff) raw = msg;
+    }
+    std::string error() const {
+        if (!raw.empty()) return raw;
+        std::stringstream ss;
+        if (eaten) {
+#ifdef PARSECPP_NO_LINECOL
+            ss << at(eoff);
+#else
+            ss << at(eline, ecol);
+#endif
+            ss << "unexpected " << showChar(ech);
+        } else if (eoff < base + (end - begin)) {
+            ss << at(eoff) << "unexpected " << showChar(begin[eoff - base]);
+        } else {
+            ss << at(eoff) << "unexpected end of input";
+        }
+        int n = 0;
+        for (int i = 0; i < nexpects; ++i) {
+            if (expects[i].kind != Expect::Message) ++n;
+        }
+        for (int i = 0, j = 0; i < nexpects; ++i) {
+            const Expect &e = expects[i];
+            if (e.kind == Expect::Message) continue;
+            ss << (j == 0 ? ", expecting " : j == n - 1 ? " or " : ", ");
+            ++j;
+            switch (e.kind) {
+            case Expect::Char  : ss << showChar(e.ch); break;
+            case Expect::String: ss << '"' << texts[i] << '"'; break;
+            default            : ss << texts[i]; break;
+            }
+        }
+        for (int i = 0, j = 0; i < nexpects; ++i) {
+            if (expects[i].kind != Expect::Message) continue;
+            ss << (j++ ? ", " : ": ") << texts[i];
+        }
+        return ss.str();
+    }
 };
 
-template <typename T>
-using Parser = std::function<T (Source *)>;
-
 /*
-parseTest p s = case evalStateT p s of
-    Right r     -> print r
-    Left (e, _) -> putStrLn e
+a file mapped read-only into memory to give to Source without copying,
+with the kernel told that it is read from the front
 */
-template <typename T>
-void parseTest(const Parser<T> &p, const char *s) {
-    Source src = s;
-    try {
-        std::cout << p(&src) << std::endl;
-    } catch (const std::string &e) {
-        std::cout << e << std::endl;
+class MappedFile {
+    const char *p = "";
+    std::uint64_t len = 0;
+#ifndef PARSECPP_MMAP
+    std::string buf;
+#endif
+public:
+    explicit MappedFile(const char *path) {
+#ifdef PARSECPP_MMAP
+        int fd = open(path, O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) < 0) {
+            int e = errno;
+            if (fd >= 0) close(fd);
+            throw std::system_error(e, std::generic_category(), path);
+        }
+        if (st.st_size > 0) {
+            void *m = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m == MAP_FAILED) {
+                int e = errno;
+                close(fd);
+                throw std::system_error(e, std::generic_category(), path);
+            }
+            madvise(m, st.st_size, MADV_SEQUENTIAL);
+            p   = static_cast<const char *>(m);
+            len = st.st_size;
+        }
+        close(fd);
+#else
+        std::ifstream f(path, std::ios::binary);
+        if (!f) throw std::system_error(ENOENT, std::generic_category(), path);
+        buf.assign(std::istreambuf_iterator<char>(f),
+                   std::istreambuf_iterator<char>());
+        p   = buf.data();
+        len = buf.size();
+#endif
     }
-}
+    ~MappedFile() {
+#ifdef PARSECPP_MMAP
+        if (len) munmap(const_cast<char *>(p), len);
+#endif
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    const char *data() const { return p; }
+    std::uint64_t size() const { return len; }
+    operator std::string_view() const { return std::string_view(p, len); }
+};
+
+/* thrown by operator() without a message: Source::error() formats it */
+struct ParseError : public std::runtime_error {
+    ParseError() : std::runtime_error("parse error") {}
+    ParseError(const std::string &msg) : std::runtime_error(msg) {}
+};
 
 /*
-anyChar = StateT $ anyChar where
-    anyChar (x:xs) = Right (x, xs)
-    anyChar    xs  = Left ("too short", xs)
+Either (e, s) (a, s) without the payload of Left:
+the message of a failure is kept by Source.
+
+The value is only constructed on success, so T needs no default
+constructor, and it is moved out of an rvalue Result.
 */
-Parser<char> anyChar = [](Source *s) {
-    char ch = s->peek();
-    s->next();
-    return ch;
+template <typename T>
+class Result {
+    std::optional<T> value;
+public:
+    Result() {}
+    Result(const T &value) : value(value) {}
+    Result(T &&value) : value(std::move(value)) {}
+    explicit operator bool() const { return value.has_value(); }
+    T &operator*() & { return *value; }
+    const T &operator*() const & { return *value; }
+    T &&operator*() && { return std::move(*value); }
 };
 
 /*
-char c = satisfy (== c) <|> left ("not char " ++ show c)
+a set of bytes as a 256-bit table: a test is one lookup that can be
+inlined, and it is defined for every char, negative or not
 */
-Parser<char> char1(char c) {
-    return [=](Source *s) {
-        char ch = s->peek();
-        if (c != ch) {
-            throw s->ex(std::string("not char '") + c + "': '" + ch + "'");
-        }
-        s->next();
-        return ch;
-    };
+class CharSet {
+    std::uint64_t bits[4];
+public:
+    constexpr CharSet() : bits{0, 0, 0, 0} {}
+    constexpr bool operator()(char ch) const {
+        unsigned char c = ch;
+        return (bits[c >> 6] & std::uint64_t(1) << (c & 63)) != 0;
+    }
+    constexpr CharSet &add(char ch) {
+        unsigned char c = ch;
+        bits[c >> 6] |= std::uint64_t(1) << (c & 63);
+        return *this;
+    }
+    constexpr CharSet operator|(const CharSet &s) const {
+        CharSet ret;
+        for (int i = 0; i < 4; ++i) ret.bits[i] = bits[i] | s.bits[i];
+        return ret;
+    }
+    constexpr CharSet operator&(const CharSet &s) const {
+        CharSet ret;
+        for (int i = 0; i < 4; ++i) ret.bits[i] = bits[i] & s.bits[i];
+        return ret;
+    }
+    constexpr std::uint64_t word(int i) const { return bits[i]; }
+    constexpr CharSet operator~() const {
+        CharSet ret;
+        for (int i = 0; i < 4; ++i) ret.bits[i] = ~bits[i];
+        return ret;
+    }
+};
+constexpr CharSet range(char lo, char hi) {
+    CharSet ret;
+    for (int c = (unsigned char)lo; c <= (unsigned char)hi; ++c) ret.add(c);
+    return ret;
+}
+constexpr CharSet oneOf(std::string_view cs) {
+    CharSet ret;
+    for (char ch : cs) ret.add(ch);
+    return ret;
+}
+constexpr CharSet noneOf(std::string_view cs) {
+    return ~oneOf(cs);
 }
 
 /*
-satisfy f = StateT $ satisfy where
-    satisfy (x:xs) | not $ f x = Left (": " ++ show x, x:xs)
-    satisfy    xs              = runStateT anyChar xs
+what a parser can start with: the bytes its first step can take and
+whether it can succeed on none. Unless it is nullable, a parser fails
+without consuming on a byte outside the set, so || can pass it by.
 */
-Parser<char> satisfy(const std::function<bool (char)> &f) {
-    return [=](Source *s) {
-        char ch = s->peek();
-        if (!f(ch)) throw s->ex(std::string("error: '") + ch + "'");
-        s->next();
-        return ch;
-    };
-}
+struct First {
+    CharSet set;
+    bool nullable;
+    static First any() { return First{~CharSet(), true}; }
+    First operator|(const First &f) const {
+        return First{set | f.set, nullable || f.nullable};
+    }
+    /* this and then f */
+    First then(const First &f) const {
+        return nullable ? First{set | f.set, f.nullable} : *this;
+    }
+};
 
-/* right */
-template <typename T>
-Parser<T> right(const T &r) {
-    return [=](Source *) {
-        return r;
-    };
-}
+/*
+Every combinator is a type of its own with a value_type and parse(),
+which returns Result<T> without throwing. A grammar is then a tree of
+concrete types that the compiler can inline; Parser<T> below erases
+the type only where a rule has to be named, as for recursion.
+
+operator() is for hand-written parsers: it throws ParseError on failure,
+which a Parser made of one catches as a failure without a message being
+formatted; at the top level, Source::error() gives it.
+skip() runs it for where it leaves the Source only, so that a combinator
+that throws the value away does not build it. first() is conservative
+unless a combinator knows better. A verbatim
+combinator is one whose value is just the input it consumed, so that
+combinators of such can give a Span of it.
+*/
+struct ParserTag {};
+
+template <typename Self, typename T>
+struct Combinator : public ParserTag {
+    typedef T value_type;
+    static constexpr bool verbatim = false;
+    T operator()(Source *s) const {
+        Result<T> r = static_cast<const Self *>(this)->parse(s);
+        if (!r) throw ParseError();
+        return *std::move(r);
+    }
+    bool skip(Source *s) const {
+        return bool(static_cast<const Self *>(this)->parse(s));
+    }
+    First first() const { return First::any(); }
+};
+
+template <typename P>
+constexpr bool isParser = std::is_base_of_v<ParserTag, P>;
+
+template <typename P>
+using value_t = typename P::value_type;
+
+/* the value of a combinator that gives the text of its parts */
+template <bool verbatim>
+using Text = std::conditional_t<verbatim, Span, std::string>;
 
 /*
-left e = StateT $ \s -> Left (e, s)
+A named rule. It is made from a combinator, from a lambda that returns
+Result<T>, or from a hand-written lambda that returns T and throws,
+which is caught back into a Result.
+
+The rule is an immutable node behind a shared_ptr, so copying a Parser
+shares it: a rule used in many places of a grammar is built once.
+The node is also the key of its packrat table when the Source memoizes.
 */
 template <typename T>
-Parser<T> left(const std::string &msg) {
-    return [=](Source *s) -> T {
-        char ch = s->peek();
-        throw s->ex(msg + ": '" + ch + "'");
+class Parser : public Combinator<Parser<T>, T> {
+    struct Node {
+        First first = First::any();
+        virtual ~Node() {}
+        virtual Result<T> parse(Source *s) const = 0;
+        virtual bool skip(Source *s) const = 0;
     };
-}
-Parser<char> left(const std::string &msg) {
-    return left<char>(msg);
-}
-
-/* >>, *> */
-template <typename T1, typename T2>
-Parser<T2> operator>>(const Parser<T1> &p1, const Parser<T2> &p2) {
-    return [=](Source *s) {
-        p1(s);
-        return p2(s);
+    template <typename F>
+    struct Of : public Node {
+        F f;
+        Of(const F &f) : f(f) {
+            if constexpr (isParser<F>) this->first = f.first();
+        }
+        virtual Result<T> parse(Source *s) const {
+            if constexpr (!isParser<F>) {
+                return f(s);
+            } else if constexpr (std::is_same_v<value_t<F>, T>) {
+                return f.parse(s);
+            } else {
+                Result<value_t<F>> r = f.parse(s);
+                if (!r) return Result<T>();
+                return Result<T>(*std::move(r));
+            }
+        }
+        virtual bool skip(Source *s) const {
+            if constexpr (isParser<F>) {
+                return f.skip(s);
+            } else {
+                return bool(f(s));
+            }
+        }
     };
-}
-
-/* <* */
-template <typename T1, typename T2>
-Parser<T1> operator<<(const Parser<T1> &p1, const Parser<T2> &p2) {
-    return [=](Source *s) {
-        T1 ret = p1(s);
-        p2(s);
-        return ret;
+    template <typename F>
+    struct Throwing {
+        F f;
+        Result<T> operator()(Source *s) const {
+            try {
+                return Result<T>(f(s));
+            } catch (const ParseError &) {
+                return Result<T>();
+            } catch (const std::string &e) {
+                s->fail(e);
+                return Result<T>();
+            }
+        }
     };
-}
-
-/* sequence */
-template <typename T1, typename T2>
-Parser<std::string> operator+(const Parser<T1> &p1, const Parser<T2> &p2) {
-    return [=](Source *s) {
-        std::string ret;
-        ret += p1(s);
-        ret += p2(s);
-        return ret;
+    struct Memos : public Source::MemoTable {
+        struct Entry {
+            std::uint64_t end;
+            std::size_t value;  // in values, or npos if it failed
+        };
+        std::unordered_map<std::uint64_t, Entry> at;
+        std::vector<T> values;
     };
-}
+    std::shared_ptr<const Node> node;
+public:
+    template <typename P, std::enable_if_t<isParser<P> &&
+        std::is_convertible_v<value_t<P>, T>, int> = 0>
+    Parser(const P &p) : node(std::make_shared<Of<P>>(p)) {}
+    template <typename F, std::enable_if_t<!isParser<F> && std::is_same_v<
+        std::invoke_result_t<const F &, Source *>, Result<T>
+    >, int> = 0>
+    Parser(const F &f) : node(std::make_shared<Of<F>>(f)) {}
+    template <typename F, std::enable_if_t<!isParser<F> &&
+        std::is_convertible_v<std::invoke_result_t<const F &, Source *>, T>,
+    int> = 0>
+    Parser(const F &f) : node(std::make_shared<Of<Throwing<F>>>(Throwing<F> { f })) {}
+    Result<T> parse(Source *s) const {
+        return s->memoizing() ? memoized(s) : node->parse(s);
+    }
+    bool skip(Source *s) const {
+        return s->memoizing() ? bool(memoized(s)) : node->skip(s);
+    }
+    First first() const { return node ? node->first : First::any(); }
+    /* run once per offset: later calls give the result and end kept */
+    Result<T> memoized(Source *s) const {
+        Memos &m = s->memoTable<Memos>(node.get());
+        std::uint64_t from = s->mark().offset;
+        auto it = m.at.find(from);
+        if (it != m.at.end()) {
+            s->rewind(Source::Mark{it->second.end});
+            if (it->second.value == std::string::npos) return Result<T>();
+            return Result<T>(m.values[it->second.value]);
+        }
+        Result<T> r = node->parse(s);
+        std::size_t value = std::string::npos;
+        if (r) {
+            value = m.values.size();
+            m.values.push_back(*r);
+        }
+        m.at[from] = typename Memos::Entry{s->mark().offset, value};
+        return r;
+    }
+};
 
 /*
-replicate n _ | n < 1 = []
-replicate n x         = x : replicate (n - 1) x
+memo p: p runs at most once per offset of a parse, so a grammar that
+backtracks through it stays linear. The table belongs to the Source
+and goes with it; Source::memoize() turns this on for every Parser.
 */
 template <typename T>
-Parser<std::string> operator*(int n, const Parser<T> &p) {
-    return [=](Source *s) {
-        std::string ret;
-        for (int i = 0; i < n; ++i) ret += p(s);
-        return ret;
-    };
-}
-template <typename T>
-Parser<std::string> operator*(const Parser<T> &p, int n) {
-    return n * p;
+class Memo : public Combinator<Memo<T>, T> {
+    Parser<T> p;
+public:
+    Memo(const Parser<T> &p) : p(p) {}
+    First first() const { return p.first(); }
+    Result<T> parse(Source *s) const { return p.memoized(s); }
+};
+template <typename P, std::enable_if_t<isParser<P>, int> = 0>
+Memo<value_t<P>> memo(const P &p) {
+    return Memo<value_t<P>>(Parser<value_t<P>>(p));
 }
 
 /*
-(StateT a) <|> (StateT b) = StateT f where
-    f s0 =   (a  s0) <|> (b  s0) where
-        Left (a, s1) <|> _ | s0 /= s1 = Left (     a, s1)
-        Left (a, _ ) <|> Left (b, s2) = Left (b ++ a, s2)
-        Left _       <|> b            = b
-        a            <|> _            = a
+A rule of a recursive grammar, declared before the parsers that use it
+and defined by assignment once they exist. Its constructor is constexpr,
+so a Rule at namespace scope is initialized before any other global. A
+copy made before the Rule is defined refers to it, so the Rule has to
+outlive such copies; one made after shares the body, as a Parser does,
+and a Rule built from a parser can be passed and returned freely. Parsing goes straight to the body, one virtual call as a Parser.
+A rule is defined once, as parsers built on it keep its FIRST set; one
+parsed before it is defined fails.
 */
 template <typename T>
-const Parser<T> operator||(const Parser<T> &p1, const Parser<T> &p2) {
-    return [=](Source *s) {
-        T ret;
-        Source ss = *s;
-        try {
-            ret = p1(s);
-        } catch (const std::string &e) {
-            if (*s != ss) throw;
-            ret = p2(s);
-        }
-        return ret;
-    };
-}
+class Rule : public Combinator<Rule<T>, T> {
+    Rule *root;
+    std::optional<Parser<T>> body;
+    PARSECPP_COLD static Result<T> undefined(Source *s) {
+        s->fail(Expect::message("undefined rule"));
+        return Result<T>();
+    }
+public:
+    constexpr Rule() : root(this) {}
+    Rule(const Rule &r) :
+        root(r.root->body ? this : r.root), body(r.root->body) {}
+    template <typename P, std::enable_if_t<isParser<P>, int> = 0>
+    Rule(const P &p) : root(this), body(Parser<T>(p)) {}
+    /* define the rule, the same for all its copies */
+    template <typename P, std::enable_if_t<isParser<P>, int> = 0>
+    Rule &operator=(const P &p) {
+        if (root->body) throw std::logic_error("rule defined twice");
+        root->body = Parser<T>(p);
+        return *this;
+    }
+    Rule &operator=(const Rule &r) { return *this = Parser<T>(r); }
+    First first() const { return root->body ? root->body->first() : First::any(); }
+    Result<T> parse(Source *s) const {
+        if (!root->body) return undefined(s);
+        return root->body->parse(s);
+    }
+    bool skip(Source *s) const {
+        if (!root->body) return bool(undefined(s));
+        return root->body->skip(s);
+    }
+};
 
 /*
-try (StateT p) = StateT $ \s -> case p s of
-    Left (e, _) -> Left (e, s)
-    r           -> r 
+parseTest p s = case evalStateT p s of
+    Right r     -> print r
+    Left (e, _) -> putStrLn e
 */
-template <typename T>
-Parser<T> tryp(const Parser<T> &p) {
-    return [=](Source *s) {
-        T ret;
-        Source ss = *s;
-        try {
-            ret = p(s);
-        } catch (const std::string &e) {
-            *s = ss;
-            throw;
-        }
-        return ret;
-    };
+template <typename P, std::enable_if_t<isParser<P>, int> = 0>
+void parseTest(const P &p, std::string_view s) {
+    Source src = s;
+    Result<value_t<P>> r = p.parse(&src);
+    if (r) {
+        std::cout << *r << std::endl;
+    } else {
+        std::cout << src.error() << std::endl;
+    }
 }
 
 /*
-string s = sequence [char x | x <- s]
+the indices of a batch split between workers: each takes grains from
+the front of its own range and, once that is empty, steals the back
+half of another's, so that a worker held up by long inputs is relieved.
+A range is two 32-bit ends in one atomic word.
 */
-Parser<std::string> string(const std::string &str) {
-    return [=](Source *s) {
-        for (int i = 0; i < str.length(); ++i) {
-            char ch = s->peek();
-            if (ch != str[i]) {
-                throw s->ex(std::string("not string \"") + str + "\": '" + ch + "'");
+class WorkRanges {
+    struct alignas(64) Range {
+        std::atomic<std::uint64_t> v{0};
+    };
+    std::unique_ptr<Range[]> ranges;
+    unsigned n;
+    std::uint64_t grain;
+    static std::uint64_t pack(std::uint64_t lo, std::uint64_t hi) { return lo << 32 | hi; }
+    bool take(Range &r, std::size_t *lo, std::size_t *hi) {
+        std::uint64_t v = r.v.load();
+        for (;;) {
+            std::uint64_t l = v >> 32, h = v & 0xffffffff;
+            if (l >= h) return false;
+            std::uint64_t m = std::min(grain, h - l);
+            if (r.v.compare_exchange_weak(v, pack(l + m, h))) {
+                *lo = l;
+                *hi = l + m;
+                return true;
             }
-            s->next();
         }
-        return str;
-    };
-}
+    }
+    /* only into an empty range, which no one else writes */
+    bool steal(Range &from, Range &to) {
+        std::uint64_t v = from.v.load();
+        for (;;) {
+            std::uint64_t l = v >> 32, h = v & 0xffffffff;
+            if (l >= h) return false;
+            std::uint64_t mid = l + (h - l) / 2;
+            if (from.v.compare_exchange_weak(v, pack(l, mid))) {
+                to.v.store(pack(mid, h));
+                return true;
+            }
+        }
+    }
+public:
+    WorkRanges(std::size_t total, unsigned n) : ranges(new Range[n]), n(n) {
+        if (total > 0xffffffff) throw std::length_error("batch too large");
+        for (unsigned i = 0; i < n; ++i) {
+            ranges[i].v = pack(std::uint64_t(total) * i / n, std::uint64_t(total) * (i + 1) / n);
+        }
+        grain = std::clamp<std::uint64_t>(total / (std::uint64_t(n) * 64), 1, 64);
+    }
+    /* the next grain of worker w, or false when the batch is done */
+    bool next(unsigned w, std::size_t *lo, std::size_t *hi) {
+        for (;;) {
+            if (take(ranges[w], lo, hi)) return true;
+            unsigned i = 1;
+            while (i < n && !steal(ranges[(w + i) % n], ranges[w])) ++i;
+            if (i == n) return false;
+        }
+    }
+};
 
 /*
-many p = ((:) <$> p <*> many p) <|> return []
+parse every input on its own Source, on up to threads threads (all
+cores by default), into the preallocated results and, for those that
+fail, errors. A built parser is immutable: all that a parse changes,
+packrat tables included, is in its Source, so one parser serves every
+thread. Rules have to be defined first, and a Span result refers to its
+input. An exception other than a parse failure is thrown again here.
 */
-template <typename T>
-Parser<std::string> many_(const Parser<T> &p) {
-    return [=](Source *s) {
-        std::string ret;
+template <typename P, typename In, std::enable_if_t<isParser<P>, int> = 0>
+void parseBatch(const P &p, const In &inputs, Result<value_t<P>> *results,
+        std::string *errors = nullptr, unsigned threads = 0) {
+    std::size_t total = std::size(inputs);
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = unsigned(std::min<std::size_t>(threads, std::max<std::size_t>(total, 1)));
+    WorkRanges work(total, threads);
+    std::exception_ptr error;
+    std::mutex m;
+    auto worker = [&](unsigned w) {
         try {
-            for (;;) ret += p(s);
-        } catch (const std::string &e) {}
-        return ret;
+            std::size_t lo, hi;
+            while (work.next(w, &lo, &hi)) {
+                for (std::size_t i = lo; i < hi; ++i) {
+                    Source s = std::string_view(inputs[i]);
+                    results[i] = p.parse(&s);
+                    if (errors && !results[i]) errors[i] = s.error();
+                }
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> g(m);
+            if (!error) error = std::current_exception();
+        }
     };
+    std::vector<std::thread> pool;
+    try {
+        for (unsigned w = 1; w < threads; ++w) pool.emplace_back(worker, w);
+    } catch (const std::system_error &) {
+        // fewer threads: the others steal what was meant for the rest
+    }
+    worker(0);
+    for (auto &t : pool) t.join();
+    if (error) std::rethrow_exception(error);
 }
-Parser<std::string> many(const Parser<char> &p) {
-    return many_(p);
-}
-Parser<std::string> many(const Parser<std::string> &p) {
-    return many_(p);
-}
+
+/*
+anyChar = StateT $ anyChar where
+    anyChar (x:xs) = Right (x, xs)
+    anyChar    xs  = Left ("too short", xs)
+*/
+struct AnyChar : public Combinator<AnyChar, char> {
+    static constexpr bool verbatim = true;
+    First first() const { return First{~CharSet(), false}; }
+    Result<char> parse(Source *s) const {
+        if (s->eof()) {
+            s->fail();
+            return Result<char>();
+        }
+        char ch = s->current();
+        s->advance();
+        return Result<char>(ch);
+    }
+};
+const AnyChar anyChar;
+
+/*
+char c = satisfy (== c) <|> left ("not char " ++ show c)
+*/
+class Char1 : public Combinator<Char1, char> {
+    char c;
+public:
+    static constexpr bool verbatim = true;
+    Char1(char c) : c(c) {}
+    char get() const { return c; }
+    First first() const { return First{CharSet().add(c), false}; }
+    Result<char> parse(Source *s) const {
+        if (s->eof() || s->current() != c) {
+            s->fail(Expect::char1(c));
+            return Result<char>();
+        }
+        s->advance();
+        return Result<char>(c);
+    }
+};
+Char1 char1(char c) { return Char1(c); }
+
+/*
+finds where a run of bytes in a CharSet ends. A set of up to four
+ranges, such as [0-9] or [A-Za-z_], is tested 32 bytes at a time with
+AVX2 or 16 with SSE2; other sets are looked up a byte at a time.
+*/
+class Scanner {
+    enum { MaxRanges = 4 };
+    CharSet set;
+    int n = 0;
+    unsigned char lo[MaxRanges], width[MaxRanges];
+public:
+    /* the runs of set bits are found a word at a time */
+    Scanner(const CharSet &set) : set(set) {
+        int last = -2;
+        for (int i = 0; i < 4 && n <= MaxRanges; ++i) {
+            std::uint64_t w = set.word(i);
+            while (w && n <= MaxRanges) {
+                int b = __builtin_ctzll(w);
+                std::uint64_t rest = ~w >> b;
+                int len = rest ? __builtin_ctzll(rest) : 64 - b;
+                int c = i * 64 + b;
+                if (c == last + 1) {
+                    width[n - 1] += len;
+                } else {
+                    if (n < MaxRanges) {
+                        lo[n]    = c;
+                        width[n] = len - 1;
+                    }
+                    ++n;
+                }
+                last = c + len - 1;
+                w = b + len < 64 ? w & ~std::uint64_t(0) << (b + len) : 0;
+            }
+        }
+    }
+    const char *operator()(const char *p, const char *end) const {
+#ifdef __AVX2__
+        if (n <= MaxRanges) {
+            for (; end - p >= 32; p += 32) {
+                __m256i v  = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+                __m256i in = _mm256_setzero_si256();
+                for (int i = 0; i < n; ++i) {
+                    __m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8(lo[i]));
+                    in = _mm256_or_si256(in, _mm256_cmpeq_epi8(
+                        _mm256_min_epu8(t, _mm256_set1_epi8(width[i])), t));
+                }
+                unsigned m = ~static_cast<unsigned>(_mm256_movemask_epi8(in));
+                if (m) return p + __builtin_ctz(m);
+            }
+        }
+#endif
+#ifdef __SSE2__
+        if (n <= MaxRanges) {
+            for (; end - p >= 16; p += 16) {
+                __m128i v  = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+                __m128i in = _mm_setzero_si128();
+                for (int i = 0; i < n; ++i) {
+                    __m128i t = _mm_sub_epi8(v, _mm_set1_epi8(lo[i]));
+                    in = _mm_or_si128(in, _mm_cmpeq_epi8(
+                        _mm_min_epu8(t, _mm_set1_epi8(width[i])), t));
+                }
+                unsigned m = ~_mm_movemask_epi8(in) & 0xffff;
+                if (m) return p + __builtin_ctz(m);
+            }
+        }
+#endif
+        while (p < end && set(*p)) ++p;
+        return p;
+    }
+};
+
+/*
+satisfy f = StateT $ satisfy where
+    satisfy (x:xs) | not $ f x = Left (": " ++ show x, x:xs)
+    satisfy    xs              = runStateT anyChar xs
+*/
+template <typename F>
+class Satisfy : public Combinator<Satisfy<F>, char> {
+    F f;
+public:
+    static constexpr bool verbatim = true;
+    Satisfy(const F &f) : f(f) {}
+    const F &predicate() const { return f; }
+    First first() const {
+        if constexpr (std::is_same_v<F, CharSet>) {
+            return First{f, false};
+        } else {
+            return First{~CharSet(), false};
+        }
+    }
+    Result<char> parse(Source *s) const {
+        if (s->eof() || !f(s->current())) {
+            s->fail();
+            return Result<char>();
+        }
+        char ch = s->current();
+        s->advance();
+        return Result<char>(ch);
+    }
+};
+template <typename F>
+Satisfy<F> satisfy(const F &f) { return Satisfy<F>(f); }
+
+/* right */
 template <typename T>
-Parser<std::list<T>> many(const Parser<T> &p) {
-    return [=](Source *s) {
-        std::list<T> ret;
-        try {
-            for (;;) ret.push_back(p(s));
-        } catch (const std::string &e) {}
+class Right : public Combinator<Right<T>, T> {
+    T r;
+public:
+    Right(const T &r) : r(r) {}
+    First first() const { return First{CharSet(), true}; }
+    Result<T> parse(Source *) const { return Result<T>(r); }
+    bool skip(Source *) const { return true; }
+};
+template <typename T>
+Right<std::decay_t<T>> right(const T &r) { return Right<std::decay_t<T>>(r); }
+
+/*
+left e = StateT $ \s -> Left (e, s)
+*/
+template <typename T>
+class Left : public Combinator<Left<T>, T> {
+    std::string msg;
+public:
+    static constexpr bool verbatim = true;  // never succeeds
+    Left(const std::string &msg) : msg(msg) {}
+    First first() const { return First{CharSet(), false}; }
+    Result<T> parse(Source *s) const {
+        s->fail(Expect::message(msg.c_str()));
+        return Result<T>();
+    }
+};
+template <typename T>
+Left<T> left(const std::string &msg) { return Left<T>(msg); }
+Left<char> left(const std::string &msg) { return Left<char>(msg); }
+
+/* >>, *> */
+template <typename P1, typename P2>
+class ReturnRight : public Combinator<ReturnRight<P1, P2>, value_t<P2>> {
+    P1 p1;
+    P2 p2;
+public:
+    ReturnRight(const P1 &p1, const P2 &p2) : p1(p1), p2(p2) {}
+    First first() const { return p1.first().then(p2.first()); }
+    Result<value_t<P2>> parse(Source *s) const {
+        if (!p1.skip(s)) return Result<value_t<P2>>();
+        return p2.parse(s);
+    }
+    bool skip(Source *s) const { return p1.skip(s) && p2.skip(s); }
+};
+template <typename P1, typename P2,
+    std::enable_if_t<isParser<P1> && isParser<P2>, int> = 0>
+ReturnRight<P1, P2> operator>>(const P1 &p1, const P2 &p2) {
+    return ReturnRight<P1, P2>(p1, p2);
+}
+
+/* <* */
+template <typename P1, typename P2>
+class ReturnLeft : public Combinator<ReturnLeft<P1, P2>, value_t<P1>> {
+    P1 p1;
+    P2 p2;
+public:
+    ReturnLeft(const P1 &p1, const P2 &p2) : p1(p1), p2(p2) {}
+    First first() const { return p1.first().then(p2.first()); }
+    Result<value_t<P1>> parse(Source *s) const {
+        Result<value_t<P1>> ret = p1.parse(s);
+        if (!ret || !p2.skip(s)) return Result<value_t<P1>>();
         return ret;
-    };
+    }
+    bool skip(Source *s) const { return p1.skip(s) && p2.skip(s); }
+};
+template <typename P1, typename P2,
+    std::enable_if_t<isParser<P1> && isParser<P2>, int> = 0>
+ReturnLeft<P1, P2> operator<<(const P1 &p1, const P2 &p2) {
+    return ReturnLeft<P1, P2>(p1, p2);
+}
+
+/* sequence */
+template <typename P1, typename P2>
+class Sequence : public Combinator<Sequence<P1, P2>,
+        Text<P1::verbatim && P2::verbatim>> {
+    typedef Text<P1::verbatim && P2::verbatim> T;
+    P1 p1;
+    P2 p2;
+public:
+    static constexpr bool verbatim = P1::verbatim && P2::verbatim;
+    Sequence(const P1 &p1, const P2 &p2) : p1(p1), p2(p2) {}
+    First first() const { return p1.first().then(p2.first()); }
+    Result<T> parse(Source *s) const {
+        if constexpr (verbatim) {
+            Source::Mark m = s->keep();
+            bool ok = p1.skip(s) && p2.skip(s);
+            Result<T> ret = ok ? Result<T>(s->span(m)) : Result<T>();
+            s->release(m);
+            return ret;
+        } else {
+            Result<value_t<P1>> r1 = p1.parse(s);
+            if (!r1) return Result<T>();
+            Result<value_t<P2>> r2 = p2.parse(s);
+            if (!r2) return Result<T>();
+            std::string ret;
+            ret += *r1;
+            ret += *r2;
+            return Result<T>(std::move(ret));
+        }
+    }
+    bool skip(Source *s) const { return p1.skip(s) && p2.skip(s); }
+};
+template <typename P1, typename P2,
+    std::enable_if_t<isParser<P1> && isParser<P2>, int> = 0>
+Sequence<P1, P2> operator+(const P1 &p1, const P2 &p2) {
+    return Sequence<P1, P2>(p1, p2);
 }
 
 /*
-many1 p = (:) <$> p <*> many p
+replicate n _ | n < 1 = []
+replicate n x         = x : replicate (n - 1) x
 */
-Parser<std::string> many1(const Parser<char> &p) {
-    return p + many(p);
+template <typename P>
+class Replicate : public Combinator<Replicate<P>, Text<P::verbatim>> {
+    typedef Text<P::verbatim> T;
+    int n;
+    P p;
+public:
+    static constexpr bool verbatim = P::verbatim;
+    Replicate(int n, const P &p) : n(n), p(p) {}
+    First first() const { return n < 1 ? First{CharSet(), true} : p.first(); }
+    Result<T> parse(Source *s) const {
+        if constexpr (verbatim) {
+            Source::Mark m = s->keep();
+            int i = 0;
+            while (i < n && p.skip(s)) ++i;
+            Result<T> ret = i == n ? Result<T>(s->span(m)) : Result<T>();
+            s->release(m);
+            return ret;
+        } else {
+            std::string ret;
+            for (int i = 0; i < n; ++i) {
+                Result<value_t<P>> r = p.parse(s);
+                if (!r) return Result<T>();
+                ret += *r;
+            }
+            return Result<T>(std::move(ret));
+        }
+    }
+    bool skip(Source *s) const {
+        for (int i = 0; i < n; ++i) {
+            if (!p.skip(s)) return false;
+        }
+        return true;
+    }
+};
+template <typename P, std::enable_if_t<isParser<P>, int> = 0>
+Replicate<P> operator*(int n, const P &p) {
+    return Replicate<P>(n, p);
 }
-Parser<std::string> many1(const Parser<std::string> &p) {
-    return p + many(p);
+template <typename P, std::enable_if_t<isParser<P>, int> = 0>
+Replicate<P> operator*(const P &p, int n) {
+    return Replicate<P>(n, p);
 }
-template <typename T>
-Parser<std::list<T>> many1(const Parser<T> &p) {
-    return [=](Source *s) {
-        std::list<T> ret;
-        ret.push_back(p(s));
-        try {
-            for (;;) ret.push_back(p(s));
-        } catch (const std::string &e) {}
+
+/*
+(StateT a) <|> (StateT b) = StateT f where
+    f s0 =   (a  s0) <|> (b  s0) where
+        Left (a, s1) <|> _ | s0 /= s1 = Left (     a, s1)
+        Left (a, _ ) <|> Left (b, s2) = Left (b ++ a, s2)
+        Left _       <|> b            = b
+        a            <|> _            = a
+*/
+template <typename T1, typename T2>
+using Either = std::conditional_t<std::is_same_v<T1, T2>, T1, std::string>;
+
+template <typename P1, typename P2>
+class Or : public Combinator<Or<P1, P2>, Either<value_t<P1>, value_t<P2>>> {
+    typedef Either<value_t<P1>, value_t<P2>> T;
+    P1 p1;
+    P2 p2;
+    First f1, f2;
+    template <typename U>
+    static Result<T> as(Result<U> r) {
+        if constexpr (std::is_same_v<U, T>) {
+            return r;
+        } else {
+            return r ? Result<T>(*std::move(r)) : Result<T>();
+        }
+    }
+    /* run p1 after all to record what it expected, before what p2 did */
+    PARSECPP_COLD void expect1(Source *s, const Source::Mark &m, int k) const {
+        if (s->expectsAt(m) < 0) return;
+        int mid = s->expectsAt(m);
+        p1.skip(s);
+        s->hoistExpects(k, mid);
+    }
+    /* whether p1 fails here without consuming: only p2 can take it */
+    bool onlyP2(Source *s) const {
+        bool end = s->eof();
+        return !f1.nullable && (end || !f1.set(s->current()))
+            && (f2.nullable || (!end && f2.set(s->current())));
+    }
+public:
+    Or(const P1 &p1, const P2 &p2) :
+        p1(p1), p2(p2), f1(p1.first()), f2(p2.first()) {}
+    const P1 &lhs() const { return p1; }
+    const P2 &rhs() const { return p2; }
+    static constexpr bool verbatim = P1::verbatim && P2::verbatim;
+    First first() const { return f1 | f2; }
+    Result<T> parse(Source *s) const {
+        Source::Mark m = s->mark();
+        if (onlyP2(s)) {
+            int k = s->expectsAt(m);
+            Result<T> ret = as(p2.parse(s));
+            if (k >= 0 && !s->moved(m)) expect1(s, m, k);
+            return ret;
+        }
+        Result<T> ret = as(p1.parse(s));
+        if (ret || s->moved(m)) return ret;
+        return as(p2.parse(s));
+    }
+    bool skip(Source *s) const {
+        Source::Mark m = s->mark();
+        if (onlyP2(s)) {
+            int k = s->expectsAt(m);
+            bool ret = p2.skip(s);
+            if (k >= 0 && !s->moved(m)) expect1(s, m, k);
+            return ret;
+        }
+        if (p1.skip(s)) return true;
+        return !s->moved(m) && p2.skip(s);
+    }
+};
+/* a Span and a std::string meet as a std::string */
+template <typename P1, typename P2,
+    std::enable_if_t<isParser<P1> && isParser<P2>, int> = 0>
+Or<P1, P2> operator||(const P1 &p1, const P2 &p2) {
+    static_assert(std::is_same_v<value_t<P1>, value_t<P2>> || (
+            std::is_convertible_v<value_t<P1>, std::string> &&
+            std::is_convertible_v<value_t<P2>, std::string>),
+        "alternatives must have the same type");
+    return Or<P1, P2>(p1, p2);
+}
+
+/*
+try (StateT p) = StateT $ \s -> case p s of
+    Left (e, _) -> Left (e, s)
+    r           -> r 
+*/
+template <typename P>
+class Try : public Combinator<Try<P>, value_t<P>> {
+    P p;
+public:
+    static constexpr bool verbatim = P::verbatim;
+    Try(const P &p) : p(p) {}
+    First first() const { return p.first(); }
+    Result<value_t<P>> parse(Source *s) const {
+        Source::Mark m = s->keep();
+        Result<value_t<P>> ret = p.parse(s);
+        if (!ret) s->rewind(m);
+        s->release(m);
+        return ret;
+    }
+    bool skip(Source *s) const {
+        Source::Mark m = s->keep();
+        bool ret = p.skip(s);
+        if (!ret) s->rewind(m);
+        s->release(m);
+        return ret;
+    }
+};
+template <typename P, std::enable_if_t<isParser<P>, int> = 0>
+Try<P> tryp(const P &p) { return Try<P>(p); }
+
+/*
+p <?> msg = StateT $ \s -> case runStateT p s of
+    Left (_, s') | s' == s -> Left ("expecting " ++ msg, s)
+    r                      -> r
+*/
+template <typename P>
+class Label : public Combinator<Label<P>, value_t<P>> {
+    P p;
+    std::string name;
+    /* replace what p expected where it started with the name */
+    PARSECPP_COLD void relabel(Source *s, const Source::Mark &m, int k, bool ok) const {
+        int n = s->expectsAt(m);
+        if (k < 0 || n < 0 || (ok && n == k)) return;
+        s->dropExpects(k);
+        s->fail(Expect::label(name.c_str()));
+    }
+public:
+    static constexpr bool verbatim = P::verbatim;
+    Label(const P &p, const std::string &name) : p(p), name(name) {}
+    const P &get() const { return p; }
+    First first() const { return p.first(); }
+    Result<value_t<P>> parse(Source *s) const {
+        Source::Mark m = s->mark();
+        int k = s->expectsAt(m);
+        Result<value_t<P>> ret = p.parse(s);
+        if (!s->moved(m)) relabel(s, m, k, bool(ret));
         return ret;
+    }
+    bool skip(Source *s) const {
+        Source::Mark m = s->mark();
+        int k = s->expectsAt(m);
+        bool ret = p.skip(s);
+        if (!s->moved(m)) relabel(s, m, k, ret);
+        return ret;
+    }
+};
+template <typename P, std::enable_if_t<isParser<P>, int> = 0>
+Label<P> label(const P &p, const std::string &name) { return Label<P>(p, name); }
+
+/*
+string s = sequence [char x | x <- s]
+*/
+class String : public Combinator<String, Span> {
+    std::string str;
+public:
+    static constexpr bool verbatim = true;
+    String(const std::string &str) : str(str) {}
+    First first() const {
+        if (str.empty()) return First{CharSet(), true};
+        return First{CharSet().add(str[0]), false};
+    }
+    Result<Span> parse(Source *s) const {
+        std::size_t len = str.length();
+        if (std::size_t(s->limit() - s->ptr()) >= len
+                && std::memcmp(s->ptr(), str.data(), len) == 0) {
+            return Result<Span>(s->take(len));
+        }
+        if (!skip(s)) return Result<Span>();
+        return Result<Span>(Span(str));  // across blocks of a stream
+    }
+    bool skip(Source *s) const {
+        std::size_t len = str.length();
+        if (std::size_t(s->limit() - s->ptr()) >= len
+                && std::memcmp(s->ptr(), str.data(), len) == 0) {
+            s->advance(len);
+            return true;
+        }
+        for (std::size_t i = 0; i < len; ++i) {
+            if (s->eof() || s->current() != str[i]) {
+                s->fail(Expect::string(str.c_str()));
+                return false;
+            }
+            s->advance();
+        }
+        return true;
+    }
+};
+String string(const std::string &str) { return String(str); }
+
+/*
+choice ss = foldr1 (<|>) [try (string s) | s <- ss]
+
+with the longest match taken in one pass through a trie of the
+literals, so the input is neither rescanned per literal nor consumed
+on failure
+*/
+class Choice : public Combinator<Choice, Span> {
+    struct Node {
+        std::uint32_t first = 0;  // the edges, sorted by byte
+        std::uint16_t count = 0;
+        int match = -1;           // the literal that ends here
+    };
+    struct Edge {
+        unsigned char ch;
+        std::uint32_t to;
     };
+    std::vector<std::string> strs;
+    std::vector<Node> nodes;
+    std::vector<Edge> edges;
+    int to(int n, unsigned char ch) const {
+        const Edge *e = edges.data() + nodes[n].first;
+        const Edge *f = e + nodes[n].count;
+        e = std::lower_bound(e, f, ch,
+            [](const Edge &e, unsigned char ch) { return e.ch < ch; });
+        return e != f && e->ch == ch ? int(e->to) : -1;
+    }
+public:
+    Choice(std::vector<std::string> ss) : strs(std::move(ss)) {
+        // lay out the trie breadth first from the sorted literals
+        std::vector<int> order(strs.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+            [this](int a, int b) { return strs[a] < strs[b]; });
+        struct Span {
+            std::size_t lo, hi;
+        };
+        std::vector<Span> spans(1, Span{0, order.size()});
+        nodes.resize(1);
+        for (std::size_t n = 0, depth = 0, next = 1; n < nodes.size(); ++n) {
+            if (n == next) {
+                ++depth;
+                next = nodes.size();
+            }
+            std::size_t i = spans[n].lo, hi = spans[n].hi;
+            if (i < hi && strs[order[i]].size() == depth) {
+                nodes[n].match = order[i];  // the first of duplicates
+                while (i < hi && strs[order[i]].size() == depth) ++i;
+            }
+            nodes[n].first = edges.size();
+            while (i < hi) {
+                unsigned char ch = strs[order[i]][depth];
+                std::size_t j = i;
+                while (j < hi && (unsigned char)strs[order[j]][depth] == ch) ++j;
+                edges.push_back(Edge{ch, std::uint32_t(nodes.size())});
+                nodes.emplace_back();
+                spans.push_back(Span{i, j});
+                ++nodes[n].count;
+                i = j;
+            }
+        }
+    }
+    First first() const {
+        First ret{CharSet(), nodes[0].match >= 0};
+        for (std::uint32_t i = 0; i < nodes[0].count; ++i) {
+            ret.set.add(edges[nodes[0].first + i].ch);
+        }
+        return ret;
+    }
+    /* the index of the longest literal ahead, or -1: nothing is consumed */
+    int find(Source *s, std::size_t *len) const {
+        Source::Mark m = s->keep();
+        int n = 0, match = nodes[0].match;
+        *len = 0;
+        for (std::size_t i = 1; !s->eof(); ++i) {
+            n = to(n, s->current());
+            if (n < 0) break;
+            s->advance();
+            if (nodes[n].match >= 0) {
+                match = nodes[n].match;
+                *len  = i;
+            }
+        }
+        s->rewind(m);
+        s->release(m);
+        return match;
+    }
+    PARSECPP_COLD void expect(Source *s) const {
+        for (auto &str : strs) s->fail(Expect::string(str.c_str()));
+    }
+    static constexpr bool verbatim = true;
+    Result<Span> parse(Source *s) const {
+        std::size_t len;
+        int match = find(s, &len);
+        if (match < 0) {
+            expect(s);
+            return Result<Span>();
+        }
+        return Result<Span>(s->take(len));
+    }
+    bool skip(Source *s) const {
+        std::size_t len;
+        int match = find(s, &len);
+        if (match < 0) {
+            expect(s);
+            return false;
+        }
+        s->advance(len);
+        return true;
+    }
+};
+inline Choice choice(std::vector<std::string> ss) {
+    return Choice(std::move(ss));
 }
 
 /*
-skipMany p = many p *> return ()
+many p = ((:) <$> p <*> many p) <|> return []
 */
+template <typename P>
+class Many : public Combinator<Many<P>, Text<P::verbatim>> {
+    typedef Text<P::verbatim> T;
+    P p;
+public:
+    static constexpr bool verbatim = P::verbatim;
+    Many(const P &p) : p(p) {}
+    First first() const { return First{p.first().set, true}; }
+    Result<T> parse(Source *s) const {
+        if constexpr (verbatim) {
+            Source::Mark m = s->keep();
+            skip(s);
+            Result<T> ret(s->span(m));
+            s->release(m);
+            return ret;
+        } else {
+            std::string ret;
+            for (;;) {
+                Result<value_t<P>> r = p.parse(s);
+                if (!r) break;
+                ret += *r;
+            }
+            return Result<T>(std::move(ret));
+        }
+    }
+    bool skip(Source *s) const {
+        for (;;) {
+            Source::Mark m = s->mark();
+            if (!p.skip(s)) {
+                s->cut(m);
+                return true;
+            }
+        }
+    }
+};
+/*
+a parser that takes one byte of a CharSet or fails without consuming,
+such as letter || digit: many runs it with a Scanner
+*/
+template <typename P>
+struct ClassOf {
+    static constexpr bool value = false;
+};
+template <>
+struct ClassOf<Char1> {
+    static constexpr bool value = true;
+    static CharSet get(const Char1 &p) { return CharSet().add(p.get()); }
+};
+template <>
+struct ClassOf<Satisfy<CharSet>> {
+    static constexpr bool value = true;
+    static CharSet get(const Satisfy<CharSet> &p) { return p.predicate(); }
+};
+template <>
+struct ClassOf<Left<char>> {
+    static constexpr bool value = true;
+    static CharSet get(const Left<char> &) { return CharSet(); }
+};
+template <typename P>
+struct ClassOf<Label<P>> {
+    static constexpr bool value = ClassOf<P>::value;
+    static CharSet get(const Label<P> &p) { return ClassOf<P>::get(p.get()); }
+};
+template <typename P1, typename P2>
+struct ClassOf<Or<P1, P2>> {
+    static constexpr bool value = ClassOf<P1>::value && ClassOf<P2>::value;
+    static CharSet get(const Or<P1, P2> &p) {
+        return ClassOf<P1>::get(p.lhs()) | ClassOf<P2>::get(p.rhs());
+    }
+};
+
+template <typename P>
+class ManyClass : public Combinator<ManyClass<P>, Span> {
+    P p;
+    Scanner scan;
+public:
+    static constexpr bool verbatim = true;
+    ManyClass(const P &p) : p(p), scan(ClassOf<P>::get(p)) {}
+    First first() const { return First{p.first().set, true}; }
+    Result<Span> parse(Source *s) const {
+        Source::Mark m = s->keep();
+        skip(s);
+        Result<Span> ret(s->span(m));
+        s->release(m);
+        return ret;
+    }
+    bool skip(Source *s) const {
+        while (!s->eof()) {
+            const char *q = scan(s->ptr(), s->limit());
+            s->advance(q - s->ptr());
+            if (q < s->limit()) break;
+        }
+        p.skip(s);  // fails here and records what was expected
+        return true;
+    }
+};
+template <typename P>
+class ManyVector : public Combinator<ManyVector<P>, std::vector<value_t<P>>> {
+    P p;
+public:
+    ManyVector(const P &p) : p(p) {}
+    First first() const { return First{p.first().set, true}; }
+    Result<std::vector<value_t<P>>> parse(Source *s) const {
+        std::vector<value_t<P>> ret;
+        for (;;) {
+            Result<value_t<P>> r = p.parse(s);
+            if (!r) break;
+            ret.push_back(*std::move(r));
+        }
+        return Result<std::vector<value_t<P>>>(std::move(ret));
+    }
+    bool skip(Source *s) const {
+        while (p.skip(s)) {}
+        return true;
+    }
+};
+template <typename T>
+constexpr bool isText = std::is_same_v<T, char> || std::is_same_v<T, std::string>
+    || std::is_same_v<T, Span>;
+
+template <typename P, std::enable_if_t<isParser<P>, int> = 0>
+auto many(const P &p) {
+    if constexpr (ClassOf<P>::value) {
+        return ManyClass<P>(p);
+    } else if constexpr (isText<value_t<P>>) {
+        return Many<P>(p);
+    } else {
+        return ManyVector<P>(p);
+    }
+}
+
+/*
+many1 p = (:) <$> p <*> many p
+*/
+template <typename P>
+class Many1Vector : public Combinator<Many1Vector<P>, std::vector<value_t<P>>> {
+    P p;
+public:
+    Many1Vector(const P &p) : p(p) {}
+    First first() const { return p.first(); }
+    Result<std::vector<value_t<P>>> parse(Source *s) const {
+        Result<value_t<P>> r = p.parse(s);
+        if (!r) return Result<std::vector<value_t<P>>>();
+        std::vector<value_t<P>> ret;
+        do {
+            ret.push_back(*std::move(r));
+            r = p.parse(s);
+        } while (r);
+        return Result<std::vector<value_t<P>>>(std::move(ret));
+    }
+    bool skip(Source *s) const {
+        if (!p.skip(s)) return false;
+        while (p.skip(s)) {}
+        return true;
+    }
+};
+template <typename P, std::enable_if_t<isParser<P>, int> = 0>
+auto many1(const P &p) {
+    if constexpr (isText<value_t<P>>) {
+        return p + many(p);
+    } else {
+        return Many1Vector<P>(p);
+    }
+}
+
+/*
+a sink takes each value as soon as it is parsed: a callable, which may
+be mutable, or an output iterator such as std::back_inserter(v). A
+combinator works on its own copy of it for each parse
+*/
+template <typename K, typename T, typename = void>
+struct IsOutputIterator : std::false_type {};
+template <typename K, typename T>
+struct IsOutputIterator<K, T,
+    std::void_t<decltype(*std::declval<K &>()++ = std::declval<T>())>> : std::true_type {};
+template <typename K, typename T>
+constexpr bool isSink = std::is_invocable_v<K &, T> || IsOutputIterator<K, T>::value;
+template <typename K, typename T>
+void put(K &k, T &&x) {
+    if constexpr (std::is_invocable_v<K &, T>) {
+        k(std::forward<T>(x));
+    } else {
+        *k++ = std::forward<T>(x);
+    }
+}
+
+/*
+manyInto p k = many p >>= mapM_ k
+
+nothing is collected, and the value is the number of items
+*/
+template <typename P, typename K>
+class ManyInto : public Combinator<ManyInto<P, K>, std::size_t> {
+    static_assert(isSink<K, value_t<P>>, "a sink is a callable or an output iterator");
+    P p;
+    K k;
+public:
+    ManyInto(const P &p, const K &k) : p(p), k(k) {}
+    First first() const { return First{p.first().set, true}; }
+    Result<std::size_t> parse(Source *s) const {
+        std::size_t n = 0;
+        K out = k;
+        for (;; ++n) {
+            Result<value_t<P>> r = p.parse(s);
+            if (!r) break;
+            put(out, *std::move(r));
+        }
+        return Result<std::size_t>(n);
+    }
+};
+template <typename P, typename K, std::enable_if_t<isParser<P>, int> = 0>
+ManyInto<P, K> manyInto(const P &p, const K &k) {
+    return ManyInto<P, K>(p, k);
+}
+
+/*
+manyFold p z f = foldl f z <$> many p
+*/
+template <typename P, typename A, typename F>
+class ManyFold : public Combinator<ManyFold<P, A, F>, A> {
+    P p;
+    A z;
+    F f;
+public:
+    ManyFold(const P &p, const A &z, const F &f) : p(p), z(z), f(f) {}
+    First first() const { return First{p.first().set, true}; }
+    Result<A> parse(Source *s) const {
+        A acc = z;
+        for (;;) {
+            Result<value_t<P>> r = p.parse(s);
+            if (!r) break;
+            acc = f(std::move(acc), std::move(*r));
+        }
+        return Result<A>(std::move(acc));
+    }
+};
+template <typename P, typename A, typename F, std::enable_if_t<isParser<P>, int> = 0>
+ManyFold<P, A, F> manyFold(const P &p, const A &z, const F &f) {
+    return ManyFold<P, A, F>(p, z, f);
+}
+
+/*
+sepBy  p sep = sepBy1 p sep <|> return []
+sepBy1 p sep = (:) <$> p <*> many (sep *> p)
+
+as in many (sep *> p), a separator that is not followed by an item
+fails the whole, once it has consumed input
+*/
+template <typename P, typename Sep>
+class SepBy : public Combinator<SepBy<P, Sep>, std::vector<value_t<P>>> {
+    P p;
+    Sep sep;
+    bool one;
+public:
+    SepBy(const P &p, const Sep &sep, bool one) : p(p), sep(sep), one(one) {}
+    First first() const {
+        First f = p.first();
+        return one ? f : First{f.set, true};
+    }
+    /* give each item to k as it is parsed: false if it fails */
+    template <typename K>
+    bool each(Source *s, K &k) const {
+        Source::Mark m = s->mark();
+        Result<value_t<P>> r = p.parse(s);
+        if (!r) return !one && !s->moved(m);
+        for (;;) {
+            put(k, *std::move(r));
+            m = s->mark();
+            if (!sep.skip(s)) return !s->moved(m);
+            r = p.parse(s);
+            if (!r) return !s->moved(m);
+        }
+    }
+    Result<std::vector<value_t<P>>> parse(Source *s) const {
+        std::vector<value_t<P>> ret;
+        auto out = std::back_inserter(ret);
+        if (!each(s, out)) return Result<std::vector<value_t<P>>>();
+        return Result<std::vector<value_t<P>>>(std::move(ret));
+    }
+    bool skip(Source *s) const {
+        Source::Mark m = s->mark();
+        if (!p.skip(s)) return !one && !s->moved(m);
+        for (;;) {
+            m = s->mark();
+            if (!sep.skip(s) || !p.skip(s)) return !s->moved(m);
+        }
+    }
+};
+template <typename P, typename Sep,
+    std::enable_if_t<isParser<P> && isParser<Sep>, int> = 0>
+SepBy<P, Sep> sepBy(const P &p, const Sep &sep) {
+    return SepBy<P, Sep>(p, sep, false);
+}
+template <typename P, typename Sep,
+    std::enable_if_t<isParser<P> && isParser<Sep>, int> = 0>
+SepBy<P, Sep> sepBy1(const P &p, const Sep &sep) {
+    return SepBy<P, Sep>(p, sep, true);
+}
+
+/*
+sepByInto p sep k = sepBy p sep >>= mapM_ k
+*/
+template <typename P, typename Sep, typename K>
+class SepByInto : public Combinator<SepByInto<P, Sep, K>, std::size_t> {
+    static_assert(isSink<K, value_t<P>>, "a sink is a callable or an output iterator");
+    SepBy<P, Sep> p;
+    K k;
+public:
+    SepByInto(const SepBy<P, Sep> &p, const K &k) : p(p), k(k) {}
+    First first() const { return p.first(); }
+    Result<std::size_t> parse(Source *s) const {
+        std::size_t n = 0;
+        K out = k;
+        auto count = [&](value_t<P> &&x) {
+            put(out, std::move(x));
+            ++n;
+        };
+        if (!p.each(s, count)) return Result<std::size_t>();
+        return Result<std::size_t>(n);
+    }
+};
+template <typename P, typename Sep, typename K,
+    std::enable_if_t<isParser<P> && isParser<Sep>, int> = 0>
+SepByInto<P, Sep, K> sepByInto(const P &p, const Sep &sep, const K &k) {
+    return SepByInto<P, Sep, K>(sepBy(p, sep), k);
+}
+template <typename P, typename Sep, typename K,
+    std::enable_if_t<isParser<P> && isParser<Sep>, int> = 0>
+SepByInto<P, Sep, K> sepBy1Into(const P &p, const Sep &sep, const K &k) {
+    return SepByInto<P, Sep, K>(sepBy1(p, sep), k);
+}
+
+/*
+skip p = p *> return ()
+*/
+template <typename P>
+class Skip : public Combinator<Skip<P>, Unit> {
+    P p;
+public:
+    Skip(const P &p) : p(p) {}
+    First first() const { return p.first(); }
+    Result<Unit> parse(Source *s) const {
+        if (!p.skip(s)) return Result<Unit>();
+        return Result<Unit>(Unit());
+    }
+    bool skip(Source *s) const { return p.skip(s); }
+};
+template <typename P, std::enable_if_t<isParser<P>, int> = 0>
+Skip<P> skip(const P &p) { return Skip<P>(p); }
+
+/*
+skipMany  p = many  p *> return ()
+skipMany1 p = many1 p *> return ()
+*/
+template <typename P, std::enable_if_t<isParser<P>, int> = 0>
+auto skipMany(const P &p) { return skip(many(p)); }
+template <typename P, std::enable_if_t<isParser<P>, int> = 0>
+auto skipMany1(const P &p) { return skip(many1(p)); }
+
+/*
+chainl1 p op = p >>= rest where
+    rest x = do { f <- op; y <- p; rest (f x y) } <|> return x
+
+op gives a function such as a function pointer, and each one is applied
+as soon as its right operand is parsed: a long chain takes no memory
+*/
+template <typename P, typename Op>
+class ChainL1 : public Combinator<ChainL1<P, Op>, value_t<P>> {
+    P p;
+    Op op;
+public:
+    ChainL1(const P &p, const Op &op) : p(p), op(op) {}
+    First first() const { return p.first(); }
+    Result<value_t<P>> parse(Source *s) const {
+        Result<value_t<P>> x = p.parse(s);
+        if (!x) return x;
+        for (;;) {
+            Source::Mark m = s->mark();
+            Result<value_t<Op>> f = op.parse(s);
+            if (!f) {
+                if (s->moved(m)) return Result<value_t<P>>();
+                return x;
+            }
+            Result<value_t<P>> y = p.parse(s);
+            if (!y) {
+                if (s->moved(m)) return y;
+                return x;
+            }
+            *x = (*f)(*std::move(x), *std::move(y));
+        }
+    }
+};
+template <typename P, typename Op,
+    std::enable_if_t<isParser<P> && isParser<Op>, int> = 0>
+ChainL1<P, Op> chainl1(const P &p, const Op &op) {
+    return ChainL1<P, Op>(p, op);
+}
+
+/*
+chainr1 p op = scan where
+    scan   = p >>= rest
+    rest x = do { f <- op; y <- scan; return (f x y) } <|> return x
+
+the operands are kept until the end of the chain, then folded from the
+right
+*/
+template <typename P, typename Op>
+class ChainR1 : public Combinator<ChainR1<P, Op>, value_t<P>> {
+    P p;
+    Op op;
+public:
+    ChainR1(const P &p, const Op &op) : p(p), op(op) {}
+    First first() const { return p.first(); }
+    Result<value_t<P>> parse(Source *s) const {
+        Result<value_t<P>> x = p.parse(s);
+        if (!x) return x;
+        std::vector<value_t<P>> xs;
+        std::vector<value_t<Op>> fs;
+        xs.push_back(*std::move(x));
+        for (;;) {
+            Source::Mark m = s->mark();
+            Result<value_t<Op>> f = op.parse(s);
+            if (!f) {
+                if (s->moved(m)) return Result<value_t<P>>();
+                break;
+            }
+            Result<value_t<P>> y = p.parse(s);
+            if (!y) {
+                if (s->moved(m)) return y;
+                break;
+            }
+            fs.push_back(*std::move(f));
+            xs.push_back(*std::move(y));
+        }
+        value_t<P> ret = std::move(xs.back());
+        for (std::size_t i = fs.size(); i-- > 0;) {
+            ret = fs[i](std::move(xs[i]), std::move(ret));
+        }
+        return Result<value_t<P>>(std::move(ret));
+    }
+};
+template <typename P, typename Op,
+    std::enable_if_t<isParser<P> && isParser<Op>, int> = 0>
+ChainR1<P, Op> chainr1(const P &p, const Op &op) {
+    return ChainR1<P, Op>(p, op);
+}
+
+/*
+buildExpressionParser table term
+
+with the table given as infix operators, each with its symbol, its
+precedence (the higher binds tighter), its associativity and its
+function. Precedence climbing takes one loop per operand whatever the
+number of levels, and the symbols are matched in one pass by a Choice.
+*/
+enum Assoc { AssocLeft, AssocRight };
+
 template <typename T>
-Parser<std::string> skipMany(const Parser<T> &p) {
-    return many(p) >> right<std::string>("");
+struct Operator {
+    std::string symbol;
+    int prec;
+    Assoc assoc;
+    T (*f)(T, T);
+};
+
+template <typename P>
+class Expression : public Combinator<Expression<P>, value_t<P>> {
+    typedef value_t<P> T;
+    P term;
+    std::vector<Operator<T>> ops;
+    Choice symbols;
+    static std::vector<std::string> symbolsOf(const std::vector<Operator<T>> &ops) {
+        std::vector<std::string> ret;
+        for (auto &op : ops) ret.push_back(op.symbol);
+        return ret;
+    }
+    /*
+    the operators from prec up, and their operands: the operator found
+    after them, which binds looser, is left in *i and *len for a caller
+    */
+    Result<T> climb(Source *s, int prec, int *i, std::size_t *len) const {
+        Result<T> x = term.parse(s);
+        if (!x) return x;
+        *i = symbols.find(s, len);
+        for (;;) {
+            if (*i < 0) {
+                symbols.expect(s);
+                return x;
+            }
+            const Operator<T> &op = ops[*i];
+            if (op.prec < prec) return x;
+            s->advance(*len);
+            Result<T> y = climb(s, op.assoc == AssocLeft ? op.prec + 1 : op.prec, i, len);
+            if (!y) return y;
+            *x = op.f(*std::move(x), *std::move(y));
+        }
+    }
+public:
+    Expression(const std::vector<Operator<T>> &ops, const P &term) :
+        term(term), ops(ops), symbols(symbolsOf(ops)) {}
+    First first() const { return term.first(); }
+    Result<T> parse(Source *s) const {
+        int i;
+        std::size_t len;
+        return climb(s, std::numeric_limits<int>::min(), &i, &len);
+    }
+};
+template <typename P, std::enable_if_t<isParser<P>, int> = 0>
+Expression<P> buildExpressionParser(
+        const std::vector<Operator<value_t<P>>> &table, const P &term) {
+    return Expression<P>(table, term);
 }
 
 /*
 import Data.Char
+
+as sets in the C locale, so that they also serve as predicates
 */
-#include <cctype>
-bool isDigit   (char ch) { return std::isdigit(ch); }
-bool isUpper   (char ch) { return std::isupper(ch); }
-bool isLower   (char ch) { return std::islower(ch); }
-bool isAlpha   (char ch) { return std::isalpha(ch); }
-bool isAlphaNum(char ch) { return isalpha(ch) || isdigit(ch); }
-bool isLetter  (char ch) { return isalpha(ch) || ch == '_';   }
-bool isSpace   (char ch) { return ch == '\t'  || ch == ' ';   }
+constexpr CharSet isDigit    = range('0', '9');
+constexpr CharSet isUpper    = range('A', 'Z');
+constexpr CharSet isLower    = range('a', 'z');
+constexpr CharSet isAlpha    = isUpper | isLower;
+constexpr CharSet isAlphaNum = isAlpha | isDigit;
+constexpr CharSet isLetter   = isAlpha | oneOf("_");
+constexpr CharSet isSpace    = oneOf("\t ");
 
 /*
-digit    = satisfy isDigit    <|> left "not digit"
-upper    = satisfy isUpper    <|> left "not upper"
-lower    = satisfy isLower    <|> left "not lower"
-alpha    = satisfy isAlpha    <|> left "not alpha"
-alphaNum = satisfy isAlphaNum <|> left "not alphaNum"
-letter   = satisfy isLetter   <|> left "not letter"
+digit    = satisfy isDigit    <?> "digit"
+upper    = satisfy isUpper    <?> "upper"
+lower    = satisfy isLower    <?> "lower"
+alpha    = satisfy isAlpha    <?> "alpha"
+alphaNum = satisfy isAlphaNum <?> "alphaNum"
+letter   = satisfy isLetter   <?> "letter"
+space    = satisfy isSpace    <?> "space"
 */
-auto digit    = satisfy(isDigit   ) || left("not digit"   );
-auto upper    = satisfy(isUpper   ) || left("not upper"   );
-auto lower    = satisfy(isLower   ) || left("not lower"   );
-auto alpha    = satisfy(isAlpha   ) || left("not alpha"   );
-auto alphaNum = satisfy(isAlphaNum) || left("not alphaNum");
-auto letter   = satisfy(isLetter  ) || left("not letter"  );
-auto space    = satisfy(isSpace   ) || left("not space"   );
+const auto digit    = label(satisfy(isDigit   ), "digit"   );
+const auto upper    = label(satisfy(isUpper   ), "upper"   );
+const auto lower    = label(satisfy(isLower   ), "lower"   );
+const auto alpha    = label(satisfy(isAlpha   ), "alpha"   );
+const auto alphaNum = label(satisfy(isAlphaNum), "alphaNum");
+const auto letter   = label(satisfy(isLetter  ), "letter"  );
+const auto space    = label(satisfy(isSpace   ), "space"   );
 
 /*
 spaces = skipMany space
 */
-auto spaces = skipMany(space);
+const auto spaces = skipMany(space);
+
+/*
+eight ASCII digits, read as a little-endian word: whether they all are
+digits, and their value, with a few multiplications instead of eight
+*/
+inline bool isEightDigits(std::uint64_t v) {
+    return ((v & 0xF0F0F0F0F0F0F0F0) |
+        (((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4))
+            == 0x3333333333333333;
+}
+inline std::uint32_t eightDigits(std::uint64_t v) {
+    const std::uint64_t mask = 0x000000FF000000FF;
+    const std::uint64_t mul1 = 100 + (1000000ULL << 32);
+    const std::uint64_t mul2 = 1 + (10000ULL << 32);
+    v -= 0x3030303030303030;
+    v = v * 10 + (v >> 8);
+    return std::uint32_t(((v & mask) * mul1 + ((v >> 16) & mask) * mul2) >> 32);
+}
+
+/* the value of a digit in base 10 or 16, or 16 if it is none */
+inline unsigned digitValue(char ch) {
+    if ('0' <= ch && ch <= '9') return ch - '0';
+    if ('a' <= ch && ch <= 'f') return ch - 'a' + 10;
+    if ('A' <= ch && ch <= 'F') return ch - 'A' + 10;
+    return 16;
+}
+
+/*
+digits in base 10 or 16 into *u, eight at a time where they are in the
+buffer: the number of them, and in *over whether *u overflowed
+*/
+template <unsigned Base>
+std::size_t readDigits(Source *s, std::uint64_t *u, bool *over) {
+    std::size_t n = 0;
+    for (;;) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        if constexpr (Base == 10) {
+            while (s->limit() - s->ptr() >= 8) {
+                std::uint64_t v;
+                std::memcpy(&v, s->ptr(), 8);
+                if (!isEightDigits(v)) break;
+                *over |= __builtin_mul_overflow(*u, 100000000, u);
+                *over |= __builtin_add_overflow(*u, eightDigits(v), u);
+                s->advance(8);
+                n += 8;
+            }
+        }
+#endif
+        if (s->eof()) break;
+        unsigned d = digitValue(s->current());
+        if (d >= Base) break;
+        *over |= __builtin_mul_overflow(*u, Base, u);
+        *over |= __builtin_add_overflow(*u, d, u);
+        s->advance();
+        ++n;
+    }
+    return n;
+}
+
+/*
+integer     = sign <*> many1 digit
+natural     =          many1 digit
+hexadecimal =          many1 hexDigit
+
+read straight from the input into T: a number that does not fit T is
+a failure at its first byte
+*/
+template <typename T, unsigned Base, bool Signed>
+class Integer : public Combinator<Integer<T, Base, Signed>, T> {
+    static_assert(std::is_integral_v<T>, "an integer type");
+    /* also where the digits of a number end, so not cold */
+    static Result<T> fail(Source *s, const Expect &e) {
+        s->fail(e);
+        return Result<T>();
+    }
+public:
+    First first() const {
+        CharSet set = Base == 10 ? range('0', '9')
+            : range('0', '9') | range('a', 'f') | range('A', 'F');
+        if (Signed) set = set | oneOf("+-");
+        return First{set, false};
+    }
+    Result<T> parse(Source *s) const {
+        Expect digit = Expect::label(Base == 10 ? "digit" : "hexadecimal digit");
+        Source::Mark m = s->keep();
+        bool neg = false;
+        if (Signed && !s->eof() && (s->current() == '-' || s->current() == '+')) {
+            neg = s->current() == '-';
+            s->advance();
+        }
+        std::uint64_t u = 0;
+        bool over = false;
+        std::size_t n = readDigits<Base>(s, &u, &over);
+        std::uint64_t max = neg ? std::is_signed_v<T> ?
+            std::uint64_t(std::numeric_limits<T>::max()) + 1 : 0 :
+            std::uint64_t(std::numeric_limits<T>::max());
+        if (n == 0 || over || u > max) {
+            if (n > 0) s->rewind(m);
+            s->release(m);
+            return fail(s, n == 0 ? digit : Expect::message("number out of range"));
+        }
+        s->release(m);
+        fail(s, digit);  // where the digits end
+        return Result<T>(T(neg ? 0 - u : u));
+    }
+};
+template <typename T = int>
+const Integer<T, 10, true> integer{};
+template <typename T = unsigned>
+const Integer<T, 10, false> natural{};
+template <typename T = unsigned>
+const Integer<T, 16, false> hexadecimal{};
+
+/*
+floating = sign <*> many1 digit <*> option "" fraction <*> option "" exponent
+
+the digits are gathered into an integer: if it and the power of 10 are
+exact in T, one multiplication or division rounds correctly (Clinger's
+fast path); otherwise std::from_chars converts the bytes
+*/
+template <typename T>
+class Floating : public Combinator<Floating<T>, T> {
+    static_assert(std::is_floating_point_v<T>, "a floating point type");
+    static bool sign(Source *s) {
+        if (s->eof() || (s->current() != '-' && s->current() != '+')) return false;
+        bool neg = s->current() == '-';
+        s->advance();
+        return neg;
+    }
+    /* '.' or an exponent, taken only when digits follow it */
+    static int part(Source *s, std::string_view cs, bool *neg, std::uint64_t *u, bool *over) {
+        if (s->eof() || cs.find(s->current()) == cs.npos) return 0;
+        Source::Mark m = s->keep();
+        s->advance();
+        if (neg) *neg = sign(s);
+        int n = readDigits<10>(s, u, over);
+        if (n == 0) s->rewind(m);
+        s->release(m);
+        return n;
+    }
+    /* whether digits with an exponent, out of range, are too large rather
+       than too small: the place of the first significant digit tells */
+    static bool tooLarge(const char *p, const char *end) {
+        const char *e = std::find_if(p, end, [](char ch) { return ch == 'e' || ch == 'E'; });
+        std::int64_t order = 0;
+        while (p < e && *p == '0') ++p;
+        if (p < e && *p != '.') {
+            for (; p < e && *p != '.'; ++p) ++order;
+        } else if (p < e) {
+            for (++p; p < e && *p == '0'; ++p) --order;
+        }
+        if (e < end) {
+            bool eneg = *++e == '-';
+            if (*e == '-' || *e == '+') ++e;
+            std::int64_t x = 0;
+            for (; e < end && x < 100000; ++e) x = x * 10 + (*e - '0');
+            order += eneg ? -x : x;
+        }
+        return order > 0;
+    }
+    PARSECPP_COLD static Result<T> slow(Source *s, const Source::Mark &m) {
+        Span text = s->span(m);
+        const char *p = text.data(), *end = p + text.size();
+        bool neg = *p == '-';
+        if (*p == '-' || *p == '+') ++p;
+        T ret;
+        if (std::from_chars(p, end, ret).ec == std::errc::result_out_of_range) {
+            if (tooLarge(p, end)) {
+                s->rewind(m);
+                s->fail(Expect::message("number out of range"));
+                return Result<T>();
+            }
+            ret = 0;  // underflow: too small for T, so zero
+        }
+        return Result<T>(neg ? -ret : ret);
+    }
+public:
+    First first() const { return First{range('0', '9') | oneOf("+-"), false}; }
+    Result<T> parse(Source *s) const {
+        Source::Mark m = s->keep();
+        bool neg = sign(s), eneg = false, over = false, eover = false;
+        std::uint64_t u = 0, e = 0;
+        if (readDigits<10>(s, &u, &over) == 0) {
+            s->fail(Expect::label("digit"));
+            s->release(m);
+            return Result<T>();
+        }
+        int nfrac = part(s, ".", nullptr, &u, &over);  // on into u
+        part(s, "eE", &eneg, &e, &eover);
+        std::int64_t exp10 = eover || e > 100000 ? 100000 : std::int64_t(e);
+        exp10 = (eneg ? -exp10 : exp10) - nfrac;
+        const int digits = std::numeric_limits<T>::digits;
+        const std::int64_t exact = digits > 24 ? 22 : 10;
+        Result<T> ret;
+        if (!over && u <= std::uint64_t(1) << digits
+                && -exact <= exp10 && exp10 <= exact) {
+            static const T pow10[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+            };
+            T x = T(u);
+            x = exp10 < 0 ? x / pow10[-exp10] : x * pow10[exp10];
+            ret = Result<T>(neg ? -x : x);
+        } else {
+            ret = slow(s, m);
+        }
+        s->release(m);
+        return ret;
+    }
+};
+template <typename T = double>
+const Floating<T> floating{};
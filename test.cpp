@@ -1,4 +1,47 @@
 #include "parsecpp.cpp"
+#include <fstream>
+#include <cstdio>
+
+int add(int x, int y) { return x + y; }
+int mul(int x, int y) { return x * y; }
+int sub(int x, int y) { return x - y; }
+int power(int x, int y) { int r = 1; while (y-- > 0) r *= x; return r; }
+
+Rule<int> factor;
+auto expr = buildExpressionParser({
+    {"+", 1, AssocLeft, add}, {"*", 2, AssocLeft, mul},
+}, factor);
+
+// a rule built from a parser owns it, so it can be returned
+Rule<int> numbered() {
+    Rule<int> r = char1('#') >> natural<int>;
+    return r;
+}
+
+// gives its text n bytes at a time, so that tokens cross blocks
+class ChunkReader : public Reader {
+    std::string text;
+    std::size_t pos = 0, n;
+public:
+    ChunkReader(const std::string &text, std::size_t n) : text(text), n(n) {}
+    virtual std::size_t read(char *buf, std::size_t len) {
+        len = std::min({len, n, text.size() - pos});
+        std::memcpy(buf, text.data() + pos, len);
+        pos += len;
+        return len;
+    }
+};
+
+template <typename P>
+void streamTest(const P &p, const std::string &text, std::size_t n) {
+    Source src(std::unique_ptr<Reader>(new ChunkReader(text, n)));
+    Result<value_t<P>> r = p.parse(&src);
+    if (r) {
+        std::cout << *r << std::endl;
+    } else {
+        std::cout << src.error() << std::endl;
+    }
+}
 
 int main() {
     Source s1 = "abc123";
@@ -10,4 +53,134 @@ int main() {
     auto s2a = many(alpha)(&s2);
     auto s2b = many(digit)(&s2);
     std::cout << s2a << "," << s2b << std::endl;
+
+    // operator() throws without a message; the Source formats it
+    Source s3 = "abc";
+    try {
+        many1(digit)(&s3);
+    } catch (const ParseError &) {
+        std::cout << s3.error() << std::endl;
+    }
+
+    // a mapped file: positions are worked out from the offset
+    std::ofstream("test.tmp", std::ios::binary) << "abc\n12x";
+    {
+        MappedFile f("test.tmp");
+        parseTest(many(alpha) >> char1('\n') >> many1(digit), f);
+        parseTest(many(alpha) >> char1('\n') >> many1(digit) >> char1(';'), f);
+    }
+    std::remove("test.tmp");
+
+    // streaming: a try backtracks over what it has kept across blocks
+    streamTest(tryp(string("abcdef")) || string("abcxyz"), "abcxyz", 2);
+    streamTest(many(letter) + many1(digit), "streamed123", 3);
+    streamTest(many(letter) + many1(digit), "streamed!", 3);
+    std::string lines;
+    for (int i = 0; i < 100000; ++i) lines += std::to_string(i) + "\n";
+    auto sum = manyFold(natural<long> << char1('\n'), 0L, std::plus<long>());
+    streamTest(sum, lines, 4096);
+    streamTest(sum >> char1(';'), lines + "x", 4096);
+    std::istringstream is(lines);
+    Source src(is);
+    std::cout << sum(&src) << std::endl;
+
+    // choice takes the longest literal
+    auto op = choice({"+", "++", "+=", "-", "->"});
+    parseTest(op, "++x");
+    parseTest(op, "+=1");
+    parseTest(op, "+1");
+    parseTest(op, "->");
+    parseTest(op, "*");
+
+    // memo runs a rule once per offset, however often it is backtracked to
+    int calls = 0;
+    Parser<int> counted = [&](Source *s) { ++calls; return natural<int>.parse(s); };
+    auto plain = tryp(counted << char1('!')) || tryp(counted << char1('?')) || counted;
+    auto memod = memo(counted);
+    auto once  = tryp(memod << char1('!')) || tryp(memod << char1('?')) || memod;
+    parseTest(plain, "42");
+    std::cout << "calls " << calls << std::endl;
+    calls = 0;
+    parseTest(once, "42");
+    std::cout << "calls " << calls << std::endl;
+    calls = 0;
+    Source ms = "42";
+    ms.memoize();
+    std::cout << plain(&ms) << std::endl;
+    std::cout << "calls " << calls << std::endl;
+
+    // chains fold from the left or the right; a dangling operator fails
+    auto minus = chainl1(natural<int>, char1('-') >> right(sub));
+    auto pow = chainr1(natural<int>, char1('^') >> right(power));
+    parseTest(minus, "10-3-2");
+    parseTest(pow, "2^3^2");
+    parseTest(pow, "2^");
+
+    // an item that fails part way is left out of the text many gives
+    auto ab = char1('a') + char1('b');
+    parseTest(many(ab), "ababa");
+    parseTest(many(string("ab")), "ababa");
+    parseTest(many1(ab), "ababa");
+    parseTest(many(ab) + char1('c'), "ababac");
+    parseTest(tryp(many(ab) + char1('c')) || string("abx"), "abx");
+
+    // repetition into a vector or a sink
+    auto list = sepBy(natural<int>, char1(','));
+    parseTest(list, "1,2,3");
+    parseTest(list, "");
+    parseTest(list, "1,2,");
+    parseTest(sepBy1(natural<int>, char1(',')), "");
+    long total = 0;
+    parseTest(sepByInto(natural<int>, char1(','), [&](int x) { total += x; }), "10,20,30");
+    std::cout << total << std::endl;
+    std::vector<std::string> words;
+    parseTest(manyInto(many1(letter) << spaces, std::back_inserter(words)), "to be or");
+    std::cout << words << std::endl;
+
+    // numbers read in place: one that does not fit fails at its first byte
+    parseTest(integer<int>, "-2147483648");
+    parseTest(integer<int>, "2147483648");
+    parseTest(natural<unsigned>, "4294967295");
+    parseTest(natural<unsigned>, "-1");
+    parseTest(integer<unsigned>, "-1");
+    parseTest(integer<long long>, "123456789012345678");
+    parseTest(hexadecimal<>, "ff");
+    parseTest(hexadecimal<unsigned char>, "100");
+    parseTest(floating<>, "3.25e2");
+    parseTest(floating<>, "-0.5");
+    parseTest(floating<>, "7.");
+    parseTest(floating<>, "1e400");
+    parseTest(floating<>, "1e-400");
+    parseTest(floating<>, "-2e-324");
+    parseTest(floating<float>, "1e-50");
+    parseTest(floating<>, "0.00001e-320");
+    parseTest(floating<>, "1000000e303");
+    parseTest(floating<>, std::string_view("1\0" "5", 3));
+    parseTest(floating<>, "x");
+
+    // rules that outlive the Rule they were copied from
+    auto nat = tryp(Rule<int>(natural<int>));
+    auto num = numbered() || natural<int>;
+    parseTest(nat, "12");
+    parseTest(num, "#7");
+
+    // a batch on four threads gives what parsing one by one does
+    factor = spaces >> (char1('(') >> expr << char1(')') || natural<int>) << spaces;
+    std::vector<std::string> inputs;
+    for (int i = 0; i < 1000; ++i) {
+        std::string e = std::to_string(i) + " + " + std::to_string(i % 7) + " * (1 + 2)";
+        inputs.push_back(i % 100 == 0 ? "(" + e : e);
+    }
+    std::vector<Result<int>> results(inputs.size());
+    std::vector<std::string> errors(inputs.size());
+    parseBatch(expr, inputs, results.data(), errors.data(), 4);
+    int same = 0, failed = 0;
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        Source s = std::string_view(inputs[i]);
+        Result<int> r = expr.parse(&s);
+        failed += !r;
+        same += r ? results[i] && *r == *results[i] : !results[i] && errors[i] == s.error();
+    }
+    std::cout << same << " same, " << failed << " failed" << std::endl;
+    std::cout << *results[999] << ", " << errors[100] << std::endl;
 }